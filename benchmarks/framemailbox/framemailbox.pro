@@ -0,0 +1,21 @@
+TEMPLATE = app
+TARGET = framemailbox-benchmark
+
+QT -= gui
+QT += core
+
+CONFIG += console link_pkgconfig
+CONFIG -= app_bundle
+
+PKGCONFIG += \
+        gstreamer-1.0
+
+BACKEND_DIR = $$PWD/../../src/videotexturebackend
+INCLUDEPATH += $$BACKEND_DIR
+
+SOURCES += \
+        $$BACKEND_DIR/framemailbox.cpp \
+        main.cpp
+
+HEADERS += \
+        $$BACKEND_DIR/framemailbox.h
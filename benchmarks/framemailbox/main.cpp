@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+// Measures how long the streaming thread spends handing a frame over to the
+// render thread, comparing the mutex protected hand off the backend used to do
+// with the FrameMailbox, while a simulated render thread keeps a 60Hz cadence.
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "framemailbox.h"
+
+using namespace NemoVideoBackend;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+void spin(std::chrono::microseconds duration)
+{
+    const Clock::time_point end = Clock::now() + duration;
+    while (Clock::now() < end) {
+    }
+}
+
+// The hand off as it was done before, the render thread holds the mutex
+// while it synchronizes the scene graph node.
+class LockedHandoff
+{
+public:
+    ~LockedHandoff()
+    {
+        if (m_queued) {
+            gst_buffer_unref(m_queued);
+        }
+    }
+
+    bool publish(GstBuffer *buffer)
+    {
+        QMutexLocker locker(&m_mutex);
+        GstBuffer * const bufferToRelease = m_queued;
+        m_queued = gst_buffer_ref(buffer);
+        const bool overwritten = m_fresh;
+        m_fresh = true;
+        locker.unlock();
+
+        if (bufferToRelease) {
+            gst_buffer_unref(bufferToRelease);
+        }
+        return overwritten;
+    }
+
+    bool take(std::chrono::microseconds hold)
+    {
+        QMutexLocker locker(&m_mutex);
+        const bool fresh = m_fresh;
+        m_fresh = false;
+        spin(hold);
+        return fresh;
+    }
+
+private:
+    QMutex m_mutex;
+    GstBuffer *m_queued = nullptr;
+    bool m_fresh = false;
+};
+
+class MailboxHandoff
+{
+public:
+    bool publish(GstBuffer *buffer)
+    {
+        QueuedFrame frame;
+        frame.buffer = buffer;
+        return m_mailbox.publish(frame);
+    }
+
+    bool take(std::chrono::microseconds hold)
+    {
+        QueuedFrame frame;
+        const bool fresh = m_mailbox.take(&frame);
+        if (frame.buffer) {
+            gst_buffer_unref(frame.buffer);
+        }
+        spin(hold);
+        return fresh;
+    }
+
+private:
+    FrameMailbox m_mailbox;
+};
+
+template <typename Handoff>
+QJsonObject run(int fps, std::chrono::milliseconds duration, std::chrono::microseconds hold)
+{
+    Handoff handoff;
+    std::atomic<bool> running(true);
+    int consumed = 0;
+
+    std::thread renderThread([&]() {
+        const std::chrono::microseconds interval(1000000 / 60);
+        Clock::time_point next = Clock::now();
+        while (running.load()) {
+            if (handoff.take(hold)) {
+                ++consumed;
+            }
+            next += interval;
+            std::this_thread::sleep_until(next);
+        }
+    });
+
+    GstBuffer * const buffer = gst_buffer_new();
+    std::vector<qint64> latencies;
+    int overwritten = 0;
+
+    const std::chrono::microseconds interval(1000000 / fps);
+    const Clock::time_point end = Clock::now() + duration;
+    Clock::time_point next = Clock::now();
+    while (next < end) {
+        const Clock::time_point start = Clock::now();
+        if (handoff.publish(buffer)) {
+            ++overwritten;
+        }
+        latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                Clock::now() - start).count());
+        next += interval;
+        std::this_thread::sleep_until(next);
+    }
+
+    running.store(false);
+    renderThread.join();
+    gst_buffer_unref(buffer);
+
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&latencies](double p) {
+        return latencies.empty()
+                ? 0.0
+                : latencies[std::min(latencies.size() - 1, size_t(p * latencies.size()))] / 1000.0;
+    };
+
+    QJsonObject result;
+    result.insert(QStringLiteral("fps"), fps);
+    result.insert(QStringLiteral("published"), int(latencies.size()));
+    result.insert(QStringLiteral("consumed"), consumed);
+    result.insert(QStringLiteral("overwritten"), overwritten);
+    result.insert(QStringLiteral("publishUsP50"), percentile(0.5));
+    result.insert(QStringLiteral("publishUsP99"), percentile(0.99));
+    result.insert(QStringLiteral("publishUsMax"), percentile(1.0));
+    return result;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    gst_init(&argc, &argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption durationOption(
+                QStringLiteral("duration"), QStringLiteral("Milliseconds to run each rate for."),
+                QStringLiteral("ms"), QStringLiteral("3000"));
+    QCommandLineOption holdOption(
+                QStringLiteral("hold"), QStringLiteral("Microseconds the render thread spends synchronizing."),
+                QStringLiteral("us"), QStringLiteral("2000"));
+    parser.addOption(durationOption);
+    parser.addOption(holdOption);
+    parser.process(app);
+
+    const std::chrono::milliseconds duration(parser.value(durationOption).toInt());
+    const std::chrono::microseconds hold(parser.value(holdOption).toInt());
+
+    QJsonArray locked;
+    QJsonArray mailbox;
+    for (int fps : { 60, 120, 240 }) {
+        locked.append(run<LockedHandoff>(fps, duration, hold));
+        mailbox.append(run<MailboxHandoff>(fps, duration, hold));
+    }
+
+    QJsonObject results;
+    results.insert(QStringLiteral("mutex"), locked);
+    results.insert(QStringLiteral("mailbox"), mailbox);
+
+    const QByteArray json = QJsonDocument(results).toJson();
+    fwrite(json.constData(), 1, json.size(), stdout);
+
+    return 0;
+}
@@ -0,0 +1,577 @@
+/*
+ * Copyright (c) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+// Plays a synthetic stream through the video texture backend into a VideoOutput
+// rendered offscreen and prints throughput, render thread cost, import cost and
+// memory use as JSON. Without a GPU it runs on Mesa llvmpipe, for example:
+//   EGL_PLATFORM=surfaceless QT_QPA_PLATFORM=eglfs QT_QPA_EGLFS_INTEGRATION=none \
+//       LIBGL_ALWAYS_SOFTWARE=1 videotexturebackend-benchmark --width 1920 --height 1080
+
+#include <QAbstractVideoFilter>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMediaObject>
+#include <QMediaService>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+#include <QQuickItem>
+#include <QQuickRenderControl>
+#include <QQuickWindow>
+#include <QSet>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QTimer>
+#include <QtPlugin>
+
+#include <private/qdeclarativevideooutput_p.h>
+#include <private/qgstreamerelementcontrol_p.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include <gst/gst.h>
+
+#include <sys/resource.h>
+
+#include "gstnemotesteglsink.h"
+#include "readbackpool.h"
+
+Q_IMPORT_PLUGIN(NemoVideoTextureBackendPlugin)
+
+namespace {
+
+// Hands the backend's sink to the benchmark the way the GStreamer media service would.
+class SinkControl : public QGStreamerElementControl
+{
+public:
+    explicit SinkControl(QObject *parent)
+        : QGStreamerElementControl(parent)
+    {
+    }
+
+    ~SinkControl()
+    {
+        setElement(nullptr);
+    }
+
+    void setElement(GstElement *element) override
+    {
+        if (m_sink) {
+            gst_object_unref(GST_OBJECT(m_sink));
+        }
+        m_sink = element ? GST_ELEMENT(gst_object_ref(GST_OBJECT(element))) : nullptr;
+    }
+
+    GstElement *sink() const { return m_sink; }
+
+private:
+    GstElement *m_sink = nullptr;
+};
+
+class MediaService : public QMediaService
+{
+public:
+    MediaService()
+        : QMediaService(nullptr)
+        , m_control(new SinkControl(this))
+    {
+    }
+
+    QMediaControl *requestControl(const char *name) override
+    {
+        return qstrcmp(name, QGStreamerVideoSinkControl_iid) == 0 ? m_control : nullptr;
+    }
+
+    void releaseControl(QMediaControl *) override
+    {
+    }
+
+    SinkControl *control() const { return m_control; }
+
+private:
+    SinkControl * const m_control;
+};
+
+class MediaObject : public QMediaObject
+{
+public:
+    explicit MediaObject(QMediaService *service)
+        : QMediaObject(nullptr, service)
+    {
+    }
+};
+
+}
+
+// Maps every frame and does nothing else with it than wait for cost milliseconds, the cost of
+// getting the pixels to a filter.
+class ReadbackFilter : public QAbstractVideoFilter
+{
+    Q_OBJECT
+public:
+    QVideoFilterRunnable *createFilterRunnable() override
+    {
+        return new Runnable(this);
+    }
+
+    QAtomicInt mapped;
+    int cost = 0;
+
+private:
+    class Runnable : public QVideoFilterRunnable
+    {
+    public:
+        explicit Runnable(ReadbackFilter *filter) : m_filter(filter) {}
+
+        QVideoFrame run(QVideoFrame *input, const QVideoSurfaceFormat &, RunFlags) override
+        {
+            if (input->map(QAbstractVideoBuffer::ReadOnly)) {
+                m_filter->mapped.ref();
+                input->unmap();
+            }
+            if (m_filter->cost > 0) {
+                QThread::msleep(m_filter->cost);
+            }
+            return *input;
+        }
+
+    private:
+        ReadbackFilter * const m_filter;
+    };
+};
+
+class MediaSource : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QObject *mediaObject READ mediaObject CONSTANT)
+public:
+    explicit MediaSource(QMediaObject *mediaObject)
+        : m_mediaObject(mediaObject)
+    {
+    }
+
+    QObject *mediaObject() const { return m_mediaObject; }
+
+private:
+    QMediaObject * const m_mediaObject;
+};
+
+namespace {
+
+QJsonObject summarize(QVector<double> values)
+{
+    QJsonObject summary;
+    if (values.isEmpty()) {
+        return summary;
+    }
+
+    std::sort(values.begin(), values.end());
+
+    double sum = 0;
+    for (double value : values) {
+        sum += value;
+    }
+
+    summary.insert(QStringLiteral("mean"), sum / values.count());
+    summary.insert(QStringLiteral("p50"), values.at(values.count() / 2));
+    summary.insert(QStringLiteral("p99"), values.at(qMin(values.count() - 1, values.count() * 99 / 100)));
+    summary.insert(QStringLiteral("max"), values.last());
+    return summary;
+}
+
+// Page faults and readback allocations are those since the start of the run.
+QJsonObject memoryUsage(const rusage &start)
+{
+    QJsonObject memory;
+
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        memory.insert(QStringLiteral("minorFaults"), double(usage.ru_minflt - start.ru_minflt));
+        memory.insert(QStringLiteral("majorFaults"), double(usage.ru_majflt - start.ru_majflt));
+    }
+
+    const NemoVideoBackend::ReadbackPool::Statistics readback = NemoVideoBackend::ReadbackPool::instance()->statistics();
+    memory.insert(QStringLiteral("readbackAllocations"), double(readback.allocations));
+    memory.insert(QStringLiteral("readbackReuses"), double(readback.reuses));
+    memory.insert(QStringLiteral("readbackKb"), double(readback.bytes / 1024));
+
+    QFile status(QStringLiteral("/proc/self/status"));
+    if (status.open(QIODevice::ReadOnly)) {
+        for (const QByteArray &line : status.readAll().split('\n')) {
+            if (line.startsWith("VmRSS:")) {
+                memory.insert(QStringLiteral("rssKb"), line.mid(6).trimmed().split(' ').value(0).toInt());
+            } else if (line.startsWith("VmHWM:")) {
+                memory.insert(QStringLiteral("peakRssKb"), line.mid(6).trimmed().split(' ').value(0).toInt());
+            }
+        }
+    }
+    return memory;
+}
+
+// Reduces the backend's frame trace to per frame counts and import costs.
+QJsonObject frameStatistics(const QString &traceFile, double seconds)
+{
+    QFile file(traceFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QJsonObject();
+    }
+
+    const QJsonArray events = QJsonDocument::fromJson(file.readAll())
+            .object().value(QStringLiteral("traceEvents")).toArray();
+
+    QSet<qint64> arrived;
+    int presented = 0;
+    int dropped = 0;
+    QVector<double> importTimes;
+    QVector<double> latencies;
+
+    for (const QJsonValue &value : events) {
+        const QJsonObject event = value.toObject();
+        const QString name = event.value(QStringLiteral("name")).toString();
+        const double duration = event.value(QStringLiteral("dur")).toDouble();
+
+        arrived.insert(qint64(event.value(QStringLiteral("args")).toObject().value(QStringLiteral("frame")).toDouble()));
+
+        if (name == QLatin1String("dropped")) {
+            ++dropped;
+        } else if (name == QLatin1String("presented")) {
+            ++presented;
+        } else if (name == QLatin1String("import")) {
+            importTimes.append(duration);
+        } else if (name == QLatin1String("queued")) {
+            latencies.append(duration);
+        }
+    }
+
+    QJsonObject statistics;
+    statistics.insert(QStringLiteral("arrived"), arrived.count());
+    statistics.insert(QStringLiteral("presented"), presented);
+    statistics.insert(QStringLiteral("dropped"), dropped);
+    statistics.insert(QStringLiteral("fps"), seconds > 0 ? presented / seconds : 0);
+    statistics.insert(QStringLiteral("importUs"), summarize(importTimes));
+    statistics.insert(QStringLiteral("queuedUs"), summarize(latencies));
+    return statistics;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    qputenv("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_SINK", "nemotesteglsink");
+
+    QGuiApplication app(argc, argv);
+    gst_init(&argc, &argv);
+    gst_element_register(nullptr, "nemotesteglsink", GST_RANK_NONE, GST_TYPE_NEMO_TEST_EGL_SINK);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption widthOption(
+                QStringLiteral("width"), QStringLiteral("Video width."), QStringLiteral("pixels"), QStringLiteral("1280"));
+    const QCommandLineOption heightOption(
+                QStringLiteral("height"), QStringLiteral("Video height."), QStringLiteral("pixels"), QStringLiteral("720"));
+    const QCommandLineOption fpsOption(
+                QStringLiteral("fps"), QStringLiteral("Video frame rate."), QStringLiteral("fps"), QStringLiteral("30"));
+    const QCommandLineOption poolOption(
+                QStringLiteral("pool"), QStringLiteral("Buffers in the sink's pool."), QStringLiteral("count"), QStringLiteral("6"));
+    const QCommandLineOption displayRateOption(
+                QStringLiteral("display-rate"), QStringLiteral("Rate the scene is rendered at."), QStringLiteral("fps"), QStringLiteral("60"));
+    const QCommandLineOption durationOption(
+                QStringLiteral("duration"), QStringLiteral("Milliseconds to play for."), QStringLiteral("ms"), QStringLiteral("10000"));
+    const QCommandLineOption outputOption(
+                QStringLiteral("output"), QStringLiteral("Write the results to a file instead of stdout."), QStringLiteral("file"));
+    const QCommandLineOption filterOption(
+                QStringLiteral("filter"), QStringLiteral("Attach a filter which maps every frame."));
+    const QCommandLineOption filterSizeOption(
+                QStringLiteral("filter-size"), QStringLiteral("Size of the frames the filter asks for."),
+                QStringLiteral("widthxheight"));
+    const QCommandLineOption filterFormatOption(
+                QStringLiteral("filter-format"), QStringLiteral("Pixel format the filter asks for, Y8, NV12 or YUV420P."),
+                QStringLiteral("format"), QStringLiteral("BGRA32"));
+    const QCommandLineOption filterCostOption(
+                QStringLiteral("filter-cost"), QStringLiteral("Milliseconds the filter takes for a frame."),
+                QStringLiteral("ms"), QStringLiteral("0"));
+    const QCommandLineOption asyncFiltersOption(
+                QStringLiteral("async-filters"), QStringLiteral("Run filters on a worker pool with this many frames queued."),
+                QStringLiteral("count"), QStringLiteral("0"));
+    const QCommandLineOption filterRateOption(
+                QStringLiteral("filter-rate"), QStringLiteral("Maximum rate the filters run at."),
+                QStringLiteral("fps"), QStringLiteral("0"));
+    const QCommandLineOption filterCountOption(
+                QStringLiteral("filters"), QStringLiteral("Number of filters to attach."),
+                QStringLiteral("count"), QStringLiteral("1"));
+    const QCommandLineOption parallelFiltersOption(
+                QStringLiteral("parallel-filters"), QStringLiteral("Run the filters of a frame concurrently."));
+    const QCommandLineOption readbackOption(
+                QStringLiteral("async-readback"), QStringLiteral("Read frames for filters through this many pixel buffers."),
+                QStringLiteral("count"), QStringLiteral("0"));
+    const QCommandLineOption earlyReleaseOption(
+                QStringLiteral("early-release"), QStringLiteral("Return buffers to the pool once the GPU is done with them."));
+    const QCommandLineOption textureBudgetOption(
+                QStringLiteral("texture-budget"), QStringLiteral("Memory the textures of buffers not shown may take."),
+                QStringLiteral("KiB"));
+    const QCommandLineOption freezeFrameOption(
+                QStringLiteral("freeze-frame"), QStringLiteral("Show a copy of the last frame after a pause this long."),
+                QStringLiteral("ms"));
+    parser.addOptions({
+            widthOption, heightOption, fpsOption, poolOption, displayRateOption, durationOption, outputOption,
+            filterOption, filterSizeOption, filterFormatOption, filterCostOption,
+            filterRateOption, filterCountOption, parallelFiltersOption, asyncFiltersOption, readbackOption, earlyReleaseOption,
+            textureBudgetOption, freezeFrameOption });
+    parser.process(app);
+
+    const QSize size(parser.value(widthOption).toInt(), parser.value(heightOption).toInt());
+    const int fps = parser.value(fpsOption).toInt();
+    const int poolSize = parser.value(poolOption).toInt();
+    const int displayRate = parser.value(displayRateOption).toInt();
+    const int duration = parser.value(durationOption).toInt();
+
+    // Trace every frame of the run, the backend writes it out when the VideoOutput is destroyed.
+    QTemporaryDir traceDirectory;
+    const QString traceFile = traceDirectory.path() + QStringLiteral("/trace.json");
+    qputenv("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_TRACE", traceFile.toLocal8Bit());
+    qputenv("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_TRACE_SIZE", QByteArray::number(fps * duration / 1000 + 64));
+
+    qputenv("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_ASYNC_READBACK", parser.value(readbackOption).toLatin1());
+    qputenv("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_ASYNC_FILTERS", parser.value(asyncFiltersOption).toLatin1());
+    if (parser.isSet(parallelFiltersOption)) {
+        qputenv("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_PARALLEL_FILTERS", "1");
+    }
+    if (parser.isSet(earlyReleaseOption)) {
+        qputenv("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_EARLY_RELEASE", "1");
+    }
+    if (parser.isSet(textureBudgetOption)) {
+        qputenv("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_TEXTURE_BUDGET", parser.value(textureBudgetOption).toLatin1());
+    }
+    if (parser.isSet(freezeFrameOption)) {
+        qputenv("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_FREEZE_FRAME", parser.value(freezeFrameOption).toLatin1());
+    }
+
+    // Only use the statically linked backend.
+    QCoreApplication::setLibraryPaths(QStringList());
+
+    QOpenGLContext context;
+    if (!context.create()) {
+        qWarning("Failed to create an OpenGL context");
+        return 1;
+    }
+    QOffscreenSurface surface;
+    surface.setFormat(context.format());
+    surface.create();
+    context.makeCurrent(&surface);
+
+    QQuickRenderControl renderControl;
+    QQuickWindow window(&renderControl);
+    window.setGeometry(0, 0, size.width(), size.height());
+    window.contentItem()->setSize(size);
+    renderControl.initialize(&context);
+
+    QOpenGLFramebufferObject framebuffer(size, QOpenGLFramebufferObject::CombinedDepthStencil);
+    window.setRenderTarget(&framebuffer);
+
+    MediaService service;
+    MediaObject mediaObject(&service);
+    MediaSource source(&mediaObject);
+
+    QDeclarativeVideoOutput *output = new QDeclarativeVideoOutput(window.contentItem());
+    output->setSize(size);
+    output->setSource(&source);
+
+    QSize filterSize;
+    if (parser.isSet(filterSizeOption)) {
+        const QStringList dimensions = parser.value(filterSizeOption).split(QLatin1Char('x'));
+        if (dimensions.count() == 2) {
+            filterSize = QSize(dimensions.at(0).toInt(), dimensions.at(1).toInt());
+        }
+    }
+
+    // Identical filters, the results are those of the first.
+    std::vector<std::unique_ptr<ReadbackFilter>> readbackFilters;
+    for (int i = qMax(1, parser.value(filterCountOption).toInt()); i > 0; --i) {
+        ReadbackFilter * const filter = new ReadbackFilter;
+        readbackFilters.emplace_back(filter);
+
+        if (filterSize.isValid()) {
+            filter->setProperty("frameSize", filterSize);
+        }
+        filter->setProperty("framePixelFormat", parser.value(filterFormatOption));
+        filter->cost = parser.value(filterCostOption).toInt();
+        if (parser.value(filterRateOption).toDouble() > 0) {
+            filter->setProperty("maximumFrameRate", parser.value(filterRateOption).toDouble());
+        }
+        if (parser.isSet(filterOption)) {
+            QQmlListProperty<QAbstractVideoFilter> filters = output->filters();
+            filters.append(&filters, filter);
+        }
+    }
+    ReadbackFilter &filter = *readbackFilters.front();
+
+    GstElement * const sink = service.control()->sink();
+    if (!sink) {
+        qWarning("The video texture backend didn't provide a sink");
+        return 1;
+    }
+    g_object_set(G_OBJECT(sink), "buffer-count", guint(poolSize), NULL);
+
+    const QByteArray description = QStringLiteral(
+                "videotestsrc is-live=true pattern=ball ! video/x-raw,format=RGBA,width=%1,height=%2,framerate=%3/1")
+            .arg(size.width()).arg(size.height()).arg(fps).toLatin1();
+
+    GError *error = nullptr;
+    GstElement * const videoSource = gst_parse_bin_from_description(description.constData(), TRUE, &error);
+    if (!videoSource) {
+        qWarning("Failed to create the source: %s", error->message);
+        g_error_free(error);
+        return 1;
+    }
+
+    GstElement * const pipeline = gst_pipeline_new("benchmark");
+    gst_bin_add_many(GST_BIN(pipeline), videoSource, sink, NULL);
+    gst_element_link(videoSource, sink);
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    QVector<double> renderTimes;
+
+    QTimer frameTimer;
+    frameTimer.setInterval(1000 / qMax(1, displayRate));
+    QObject::connect(&frameTimer, &QTimer::timeout, [&]() {
+        QElapsedTimer timer;
+        timer.start();
+
+        renderControl.polishItems();
+        renderControl.sync();
+        renderControl.render();
+        context.functions()->glFinish();
+
+        renderTimes.append(timer.nsecsElapsed() / 1000000.0);
+
+        // There's no real swap offscreen, the backend's bookkeeping still relies on the signal.
+        emit window.frameSwapped();
+    });
+
+    QElapsedTimer elapsed;
+    rusage startUsage;
+    getrusage(RUSAGE_SELF, &startUsage);
+    elapsed.start();
+    frameTimer.start();
+    QTimer::singleShot(duration, &app, &QCoreApplication::quit);
+    app.exec();
+    frameTimer.stop();
+
+    const double seconds = elapsed.elapsed() / 1000.0;
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    const QJsonObject memory = memoryUsage(startUsage);
+
+    // Asynchronous filters report their statistics as properties of the filter.
+    const QVariant framesDropped = filter.property("framesDropped");
+    const QVariant filterLatency = filter.property("filterLatency");
+
+    // The backend reports the textures it keeps as properties of the output.
+    QJsonObject textures;
+    textures.insert(QStringLiteral("memoryKb"), output->property("textureMemory").toDouble() / 1024);
+    textures.insert(QStringLiteral("retained"), output->property("texturesRetained").toInt());
+    textures.insert(QStringLiteral("trimmed"), output->property("texturesTrimmed").toDouble());
+    if (output->property("firstSmoothFrameTime").isValid()) {
+        textures.insert(QStringLiteral("firstSmoothFrameMs"), output->property("firstSmoothFrameTime").toDouble());
+    }
+
+    delete output;
+    gst_object_unref(GST_OBJECT(pipeline));
+
+    QJsonObject configuration;
+    configuration.insert(QStringLiteral("width"), size.width());
+    configuration.insert(QStringLiteral("height"), size.height());
+    configuration.insert(QStringLiteral("fps"), fps);
+    configuration.insert(QStringLiteral("pool"), poolSize);
+    configuration.insert(QStringLiteral("displayRate"), displayRate);
+    // Swaps are signalled by the benchmark on its timer, so the swap cadence, the predicted
+    // presentation times and early release measured here don't reflect a real display.
+    configuration.insert(QStringLiteral("syntheticSwaps"), true);
+    configuration.insert(QStringLiteral("durationMs"), duration);
+    configuration.insert(QStringLiteral("earlyRelease"), parser.isSet(earlyReleaseOption));
+    configuration.insert(QStringLiteral("filter"), parser.isSet(filterOption));
+    configuration.insert(QStringLiteral("filterFormat"), parser.value(filterFormatOption));
+    if (filterSize.isValid()) {
+        configuration.insert(QStringLiteral("filterWidth"), filterSize.width());
+        configuration.insert(QStringLiteral("filterHeight"), filterSize.height());
+    }
+    configuration.insert(QStringLiteral("filterCostMs"), filter.cost);
+    configuration.insert(QStringLiteral("filters"), int(readbackFilters.size()));
+    configuration.insert(QStringLiteral("filterRate"), parser.value(filterRateOption).toDouble());
+    configuration.insert(QStringLiteral("parallelFilters"), parser.isSet(parallelFiltersOption));
+    configuration.insert(QStringLiteral("asyncFilters"), parser.value(asyncFiltersOption).toInt());
+    configuration.insert(QStringLiteral("asyncReadback"), parser.value(readbackOption).toInt());
+    if (parser.isSet(textureBudgetOption)) {
+        configuration.insert(QStringLiteral("textureBudgetKb"), parser.value(textureBudgetOption).toInt());
+    }
+    if (parser.isSet(freezeFrameOption)) {
+        configuration.insert(QStringLiteral("freezeFrameMs"), parser.value(freezeFrameOption).toInt());
+    }
+
+    QJsonObject results;
+    results.insert(QStringLiteral("configuration"), configuration);
+    results.insert(QStringLiteral("frames"), frameStatistics(traceFile, seconds));
+    results.insert(QStringLiteral("renderMs"), summarize(renderTimes));
+    results.insert(QStringLiteral("memory"), memory);
+    results.insert(QStringLiteral("textures"), textures);
+    if (parser.isSet(filterOption)) {
+        results.insert(QStringLiteral("framesMapped"), filter.mapped.load());
+        if (framesDropped.isValid()) {
+            results.insert(QStringLiteral("framesDropped"), framesDropped.toDouble());
+            results.insert(QStringLiteral("filterLatencyMs"), filterLatency.toDouble());
+        }
+    }
+
+    const QByteArray json = QJsonDocument(results).toJson();
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning("Failed to open %s", qPrintable(file.fileName()));
+            return 1;
+        }
+        file.write(json);
+    } else {
+        fwrite(json.constData(), 1, json.size(), stdout);
+    }
+
+    return 0;
+}
+
+#include "main.moc"
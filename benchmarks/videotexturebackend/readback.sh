@@ -0,0 +1,13 @@
+#!/bin/sh
+# Compares the render thread cost of reading frames back for a filter synchronously
+# and through pixel buffers at 720p, 1080p and 4K. Extra arguments are passed to
+# every run, e.g. --duration 5000.
+
+BENCHMARK=${BENCHMARK:-$(dirname "$0")/videotexturebackend-benchmark}
+
+for size in 1280x720 1920x1080 3840x2160; do
+    for readback in 0 2 3; do
+        echo "== ${size} async-readback ${readback}"
+        "$BENCHMARK" --width "${size%x*}" --height "${size#*x}" --filter --async-readback "$readback" "$@"
+    done
+done
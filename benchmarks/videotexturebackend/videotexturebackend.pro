@@ -0,0 +1,19 @@
+TEMPLATE = app
+TARGET = videotexturebackend-benchmark
+
+QT += quick
+
+CONFIG -= app_bundle
+
+# Link the backend and the stand in sink statically so the benchmark measures the tree
+# it was built from rather than whatever is installed.
+DEFINES += QT_STATICPLUGIN
+
+include(../../src/videotexturebackend/videotexturebackend.pri)
+include(../../src/testeglsink/testeglsink.pri)
+
+SOURCES += \
+        main.cpp
+
+OTHER_FILES += \
+        readback.sh
@@ -2,3 +2,9 @@ TEMPLATE = subdirs
 
 SUBDIRS = \
         src
+
+# The stand in sink and the benchmarks aren't installed, build them with
+#   qmake CONFIG+=benchmarks
+benchmarks {
+    SUBDIRS += benchmarks
+}
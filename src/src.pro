@@ -2,3 +2,7 @@ TEMPLATE = subdirs
 
 SUBDIRS = \
         videotexturebackend
+
+benchmarks {
+    SUBDIRS += testeglsink
+}
@@ -0,0 +1,659 @@
+/*
+ * Copyright (c) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "gstnemotesteglsink.h"
+
+#include <gst/interfaces/nemoeglimagememory.h>
+
+#include <GLES2/gl2.h>
+
+GST_DEBUG_CATEGORY_STATIC(gst_nemo_test_egl_sink_debug);
+#define GST_CAT_DEFAULT gst_nemo_test_egl_sink_debug
+
+#define GST_NEMO_TEST_EGL_MEMORY_TYPE "NemoTestEglMemory"
+#define DEFAULT_BUFFER_COUNT 6
+
+/* Allocator */
+
+#define GST_TYPE_NEMO_TEST_EGL_ALLOCATOR \
+    (gst_nemo_test_egl_allocator_get_type())
+#define GST_NEMO_TEST_EGL_ALLOCATOR(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_NEMO_TEST_EGL_ALLOCATOR, GstNemoTestEglAllocator))
+
+typedef struct
+{
+    GstMemory parent;
+
+    guint8 *data;
+    GLuint texture;
+    gint width;
+    gint height;
+} GstNemoTestEglMemory;
+
+struct _GstNemoTestEglAllocator
+{
+    GstAllocator parent;
+
+    EGLDisplay display;
+    EGLContext context;
+    GstVideoInfo info;
+
+    /* Textures of freed memories, deleted when the context is next current. */
+    GMutex lock;
+    GArray *released_textures;
+};
+
+typedef struct
+{
+    GstAllocatorClass parent_class;
+} GstNemoTestEglAllocatorClass;
+
+typedef struct
+{
+    EGLDisplay display;
+    EGLContext context;
+    EGLSurface draw;
+    EGLSurface read;
+} GstNemoTestEglCurrent;
+
+GType gst_nemo_test_egl_allocator_get_type(void);
+
+static void gst_nemo_test_egl_allocator_egl_image_memory_init(NemoGstEglImageMemoryInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(GstNemoTestEglAllocator, gst_nemo_test_egl_allocator, GST_TYPE_ALLOCATOR,
+        G_IMPLEMENT_INTERFACE(NEMO_GST_TYPE_EGL_IMAGE_MEMORY, gst_nemo_test_egl_allocator_egl_image_memory_init))
+
+static gboolean gst_nemo_test_egl_allocator_upload(GstNemoTestEglAllocator *self, GstNemoTestEglMemory *memory);
+
+static GstMemory *
+gst_nemo_test_egl_allocator_alloc(GstAllocator *allocator, gsize size, GstAllocationParams *params)
+{
+    GstNemoTestEglAllocator *self = GST_NEMO_TEST_EGL_ALLOCATOR(allocator);
+    GstNemoTestEglMemory *memory = g_slice_new0(GstNemoTestEglMemory);
+
+    gst_memory_init(GST_MEMORY_CAST(memory), params->flags | GST_MEMORY_FLAG_NO_SHARE,
+            allocator, NULL, size, params->align, 0, size);
+
+    memory->data = g_malloc0(size);
+    memory->width = GST_VIDEO_INFO_WIDTH(&self->info);
+    memory->height = GST_VIDEO_INFO_HEIGHT(&self->info);
+
+    /* Give the memory its texture straight away like a hardware buffer has its storage,
+     * so images can be created for pool buffers which haven't been shown yet. */
+    gst_nemo_test_egl_allocator_upload(self, memory);
+
+    return GST_MEMORY_CAST(memory);
+}
+
+static void
+gst_nemo_test_egl_allocator_free(GstAllocator *allocator, GstMemory *memory)
+{
+    GstNemoTestEglAllocator *self = GST_NEMO_TEST_EGL_ALLOCATOR(allocator);
+    GstNemoTestEglMemory *mem = (GstNemoTestEglMemory *) memory;
+
+    /* The last reference may be dropped on any thread, usually the QML render thread,
+     * where the private context can't be made current. */
+    if (mem->texture) {
+        g_mutex_lock(&self->lock);
+        g_array_append_val(self->released_textures, mem->texture);
+        g_mutex_unlock(&self->lock);
+    }
+
+    g_free(mem->data);
+    g_slice_free(GstNemoTestEglMemory, mem);
+}
+
+static gpointer
+gst_nemo_test_egl_memory_map(GstMemory *memory, gsize maxsize, GstMapFlags flags)
+{
+    (void) maxsize;
+    (void) flags;
+
+    return ((GstNemoTestEglMemory *) memory)->data;
+}
+
+static void
+gst_nemo_test_egl_memory_unmap(GstMemory *memory)
+{
+    (void) memory;
+}
+
+static GstMemory *
+gst_nemo_test_egl_memory_share(GstMemory *memory, gssize offset, gssize size)
+{
+    (void) memory;
+    (void) offset;
+    (void) size;
+
+    return NULL;
+}
+
+static gboolean
+gst_nemo_test_egl_allocator_make_current(GstNemoTestEglAllocator *self, GstNemoTestEglCurrent *saved)
+{
+    static const EGLint config_attribs[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_NONE
+    };
+    static const EGLint context_attribs[] = {
+        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_NONE
+    };
+
+    saved->display = eglGetCurrentDisplay();
+    saved->context = eglGetCurrentContext();
+    saved->draw = eglGetCurrentSurface(EGL_DRAW);
+    saved->read = eglGetCurrentSurface(EGL_READ);
+
+    eglBindAPI(EGL_OPENGL_ES_API);
+
+    if (self->context == EGL_NO_CONTEXT) {
+        EGLConfig config;
+        EGLint count = 0;
+
+        if (!eglChooseConfig(self->display, config_attribs, &config, 1, &count) || count == 0) {
+            GST_ERROR_OBJECT(self, "No GLES2 capable EGL config");
+            return FALSE;
+        }
+
+        self->context = eglCreateContext(self->display, config, EGL_NO_CONTEXT, context_attribs);
+        if (self->context == EGL_NO_CONTEXT) {
+            GST_ERROR_OBJECT(self, "Failed to create an EGL context: 0x%x", eglGetError());
+            return FALSE;
+        }
+    }
+
+    /* Needs EGL_KHR_surfaceless_context, Mesa has it on every platform. */
+    if (!eglMakeCurrent(self->display, EGL_NO_SURFACE, EGL_NO_SURFACE, self->context)) {
+        GST_ERROR_OBJECT(self, "Failed to make the EGL context current: 0x%x", eglGetError());
+        return FALSE;
+    }
+
+    g_mutex_lock(&self->lock);
+    if (self->released_textures->len > 0) {
+        glDeleteTextures(self->released_textures->len, (const GLuint *) self->released_textures->data);
+        g_array_set_size(self->released_textures, 0);
+    }
+    g_mutex_unlock(&self->lock);
+
+    return TRUE;
+}
+
+static void
+gst_nemo_test_egl_allocator_restore_current(GstNemoTestEglAllocator *self, const GstNemoTestEglCurrent *saved)
+{
+    if (saved->context != EGL_NO_CONTEXT) {
+        eglMakeCurrent(saved->display, saved->draw, saved->read, saved->context);
+    } else {
+        eglMakeCurrent(self->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
+}
+
+static gboolean
+gst_nemo_test_egl_allocator_upload(GstNemoTestEglAllocator *self, GstNemoTestEglMemory *memory)
+{
+    GstNemoTestEglCurrent saved;
+
+    if (!gst_nemo_test_egl_allocator_make_current(self, &saved)) {
+        return FALSE;
+    }
+
+    if (!memory->texture) {
+        glGenTextures(1, &memory->texture);
+        glBindTexture(GL_TEXTURE_2D, memory->texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, memory->width, memory->height, 0,
+                GL_RGBA, GL_UNSIGNED_BYTE, memory->data);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, memory->texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, memory->width, memory->height,
+                GL_RGBA, GL_UNSIGNED_BYTE, memory->data);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    /* The render thread samples the texture through an EGLImage as soon as the frame is shown. */
+    glFinish();
+
+    gst_nemo_test_egl_allocator_restore_current(self, &saved);
+
+    return TRUE;
+}
+
+static EGLImageKHR
+gst_nemo_test_egl_allocator_create_image(GstMemory *memory, EGLDisplay display, EGLContext context)
+{
+    static PFNEGLCREATEIMAGEKHRPROC create_image = NULL;
+    static const EGLint attribs[] = {
+        EGL_GL_TEXTURE_LEVEL_KHR, 0,
+        EGL_IMAGE_PRESERVED_KHR, EGL_TRUE,
+        EGL_NONE
+    };
+
+    GstNemoTestEglAllocator *self = GST_NEMO_TEST_EGL_ALLOCATOR(memory->allocator);
+    GstNemoTestEglMemory *mem = (GstNemoTestEglMemory *) memory;
+
+    (void) context;
+
+    if (!create_image) {
+        create_image = (PFNEGLCREATEIMAGEKHRPROC) eglGetProcAddress("eglCreateImageKHR");
+    }
+
+    /* The image is a sibling of the texture the streaming thread uploads frames to,
+     * creating it doesn't need the private context to be current. */
+    if (!mem->texture || self->context == EGL_NO_CONTEXT) {
+        return EGL_NO_IMAGE_KHR;
+    }
+
+    return create_image(display, self->context, EGL_GL_TEXTURE_2D_KHR,
+            (EGLClientBuffer) (guintptr) mem->texture, attribs);
+}
+
+static void
+gst_nemo_test_egl_allocator_egl_image_memory_init(NemoGstEglImageMemoryInterface *iface)
+{
+    iface->create_image = gst_nemo_test_egl_allocator_create_image;
+}
+
+static void
+gst_nemo_test_egl_allocator_finalize(GObject *object)
+{
+    GstNemoTestEglAllocator *self = GST_NEMO_TEST_EGL_ALLOCATOR(object);
+
+    if (self->context != EGL_NO_CONTEXT) {
+        GstNemoTestEglCurrent saved;
+
+        if (gst_nemo_test_egl_allocator_make_current(self, &saved)) {
+            gst_nemo_test_egl_allocator_restore_current(self, &saved);
+        }
+        eglDestroyContext(self->display, self->context);
+    }
+
+    g_array_free(self->released_textures, TRUE);
+    g_mutex_clear(&self->lock);
+
+    G_OBJECT_CLASS(gst_nemo_test_egl_allocator_parent_class)->finalize(object);
+}
+
+static void
+gst_nemo_test_egl_allocator_class_init(GstNemoTestEglAllocatorClass *klass)
+{
+    GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+    GstAllocatorClass *allocator_class = GST_ALLOCATOR_CLASS(klass);
+
+    gobject_class->finalize = gst_nemo_test_egl_allocator_finalize;
+
+    allocator_class->alloc = gst_nemo_test_egl_allocator_alloc;
+    allocator_class->free = gst_nemo_test_egl_allocator_free;
+}
+
+static void
+gst_nemo_test_egl_allocator_init(GstNemoTestEglAllocator *self)
+{
+    GstAllocator *allocator = GST_ALLOCATOR_CAST(self);
+
+    allocator->mem_type = GST_NEMO_TEST_EGL_MEMORY_TYPE;
+    allocator->mem_map = gst_nemo_test_egl_memory_map;
+    allocator->mem_unmap = gst_nemo_test_egl_memory_unmap;
+    allocator->mem_share = gst_nemo_test_egl_memory_share;
+
+    GST_OBJECT_FLAG_SET(allocator, GST_ALLOCATOR_FLAG_CUSTOM_ALLOC);
+
+    self->display = EGL_NO_DISPLAY;
+    self->context = EGL_NO_CONTEXT;
+    gst_video_info_init(&self->info);
+
+    g_mutex_init(&self->lock);
+    self->released_textures = g_array_new(FALSE, FALSE, sizeof(GLuint));
+}
+
+static GstNemoTestEglAllocator *
+gst_nemo_test_egl_allocator_new(EGLDisplay display)
+{
+    GstNemoTestEglAllocator *self = g_object_new(GST_TYPE_NEMO_TEST_EGL_ALLOCATOR, NULL);
+
+    gst_object_ref_sink(self);
+    self->display = display;
+
+    return self;
+}
+
+/* Sink */
+
+enum
+{
+    PROP_0,
+    PROP_EGL_DISPLAY,
+    PROP_BUFFER_COUNT
+};
+
+enum
+{
+    SIGNAL_SHOW_FRAME,
+    SIGNAL_BUFFERS_INVALIDATED,
+    LAST_SIGNAL
+};
+
+static guint gst_nemo_test_egl_sink_signals[LAST_SIGNAL];
+
+static GstStaticPadTemplate gst_nemo_test_egl_sink_template = GST_STATIC_PAD_TEMPLATE(
+        "sink",
+        GST_PAD_SINK,
+        GST_PAD_ALWAYS,
+        GST_STATIC_CAPS(GST_VIDEO_CAPS_MAKE("RGBA")));
+
+G_DEFINE_TYPE(GstNemoTestEglSink, gst_nemo_test_egl_sink, GST_TYPE_VIDEO_SINK);
+
+static void
+gst_nemo_test_egl_sink_release_pool(GstNemoTestEglSink *self)
+{
+    if (self->pool) {
+        gst_buffer_pool_set_active(self->pool, FALSE);
+        gst_object_unref(self->pool);
+        self->pool = NULL;
+    }
+}
+
+static GstBufferPool *
+gst_nemo_test_egl_sink_ensure_pool(GstNemoTestEglSink *self, const GstVideoInfo *info)
+{
+    GstStructure *config;
+    GstCaps *caps;
+
+    if (self->pool
+            && GST_VIDEO_INFO_WIDTH(&self->info) == GST_VIDEO_INFO_WIDTH(info)
+            && GST_VIDEO_INFO_HEIGHT(&self->info) == GST_VIDEO_INFO_HEIGHT(info)) {
+        return self->pool;
+    }
+
+    if (self->pool) {
+        gst_nemo_test_egl_sink_release_pool(self);
+        g_signal_emit(self, gst_nemo_test_egl_sink_signals[SIGNAL_BUFFERS_INVALIDATED], 0);
+    }
+
+    self->info = *info;
+    self->allocator->info = *info;
+
+    self->pool = gst_buffer_pool_new();
+    config = gst_buffer_pool_get_config(self->pool);
+    caps = gst_video_info_to_caps(info);
+    gst_buffer_pool_config_set_params(config, caps, GST_VIDEO_INFO_SIZE(info),
+            self->buffer_count, self->buffer_count);
+    gst_buffer_pool_config_set_allocator(config, GST_ALLOCATOR_CAST(self->allocator), NULL);
+    gst_caps_unref(caps);
+
+    if (!gst_buffer_pool_set_config(self->pool, config)) {
+        GST_ERROR_OBJECT(self, "Failed to configure the buffer pool");
+        gst_object_unref(self->pool);
+        self->pool = NULL;
+    }
+
+    return self->pool;
+}
+
+static gboolean
+gst_nemo_test_egl_sink_start(GstBaseSink *basesink)
+{
+    GstNemoTestEglSink *self = GST_NEMO_TEST_EGL_SINK(basesink);
+
+    if (self->display == EGL_NO_DISPLAY) {
+        self->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (!eglInitialize(self->display, NULL, NULL)) {
+            GST_ELEMENT_ERROR(self, RESOURCE, OPEN_READ, ("Failed to initialize EGL"), (NULL));
+            return FALSE;
+        }
+    }
+
+    if (!self->allocator) {
+        self->allocator = gst_nemo_test_egl_allocator_new(self->display);
+    }
+
+    return TRUE;
+}
+
+static gboolean
+gst_nemo_test_egl_sink_stop(GstBaseSink *basesink)
+{
+    GstNemoTestEglSink *self = GST_NEMO_TEST_EGL_SINK(basesink);
+
+    /* Like droideglsink, let go of the last frame and every texture made from the pool. */
+    g_signal_emit(self, gst_nemo_test_egl_sink_signals[SIGNAL_SHOW_FRAME], 0, NULL);
+    g_signal_emit(self, gst_nemo_test_egl_sink_signals[SIGNAL_BUFFERS_INVALIDATED], 0);
+
+    gst_nemo_test_egl_sink_release_pool(self);
+    gst_video_info_init(&self->info);
+
+    return TRUE;
+}
+
+static gboolean
+gst_nemo_test_egl_sink_set_caps(GstBaseSink *basesink, GstCaps *caps)
+{
+    GstNemoTestEglSink *self = GST_NEMO_TEST_EGL_SINK(basesink);
+    GstVideoInfo info;
+
+    if (!gst_video_info_from_caps(&info, caps)) {
+        GST_ERROR_OBJECT(self, "Invalid caps %" GST_PTR_FORMAT, caps);
+        return FALSE;
+    }
+
+    if (!gst_nemo_test_egl_sink_ensure_pool(self, &info)) {
+        return FALSE;
+    }
+
+    GST_VIDEO_SINK_WIDTH(self) = GST_VIDEO_INFO_WIDTH(&info);
+    GST_VIDEO_SINK_HEIGHT(self) = GST_VIDEO_INFO_HEIGHT(&info);
+
+    return TRUE;
+}
+
+static gboolean
+gst_nemo_test_egl_sink_propose_allocation(GstBaseSink *basesink, GstQuery *query)
+{
+    GstNemoTestEglSink *self = GST_NEMO_TEST_EGL_SINK(basesink);
+    GstCaps *caps = NULL;
+    gboolean need_pool = FALSE;
+    GstVideoInfo info;
+    GstBufferPool *pool;
+
+    gst_query_parse_allocation(query, &caps, &need_pool);
+
+    if (!caps || !gst_video_info_from_caps(&info, caps)) {
+        return FALSE;
+    }
+
+    pool = gst_nemo_test_egl_sink_ensure_pool(self, &info);
+    if (!pool) {
+        return FALSE;
+    }
+
+    gst_query_add_allocation_pool(query, need_pool ? pool : NULL, GST_VIDEO_INFO_SIZE(&info),
+            self->buffer_count, self->buffer_count);
+    gst_query_add_allocation_param(query, GST_ALLOCATOR_CAST(self->allocator), NULL);
+
+    return TRUE;
+}
+
+static GstFlowReturn
+gst_nemo_test_egl_sink_show_frame(GstVideoSink *videosink, GstBuffer *buffer)
+{
+    GstNemoTestEglSink *self = GST_NEMO_TEST_EGL_SINK(videosink);
+    GstMemory *memory = gst_buffer_n_memory(buffer) == 1 ? gst_buffer_peek_memory(buffer, 0) : NULL;
+    GstBuffer *frame = NULL;
+
+    if (memory && memory->allocator == GST_ALLOCATOR_CAST(self->allocator)) {
+        frame = gst_buffer_ref(buffer);
+    } else {
+        /* Upstream didn't take the proposed pool, copy into it. */
+        GstVideoFrame source;
+        GstVideoFrame destination;
+
+        if (!self->pool
+                || (!gst_buffer_pool_is_active(self->pool) && !gst_buffer_pool_set_active(self->pool, TRUE))
+                || gst_buffer_pool_acquire_buffer(self->pool, &frame, NULL) != GST_FLOW_OK) {
+            GST_ELEMENT_ERROR(self, RESOURCE, WRITE, ("Failed to acquire a buffer"), (NULL));
+            return GST_FLOW_ERROR;
+        }
+
+        if (gst_video_frame_map(&source, &self->info, buffer, GST_MAP_READ)) {
+            if (gst_video_frame_map(&destination, &self->info, frame, GST_MAP_WRITE)) {
+                gst_video_frame_copy(&destination, &source);
+                gst_video_frame_unmap(&destination);
+            }
+            gst_video_frame_unmap(&source);
+        }
+
+        GST_BUFFER_PTS(frame) = GST_BUFFER_PTS(buffer);
+        GST_BUFFER_DTS(frame) = GST_BUFFER_DTS(buffer);
+        GST_BUFFER_DURATION(frame) = GST_BUFFER_DURATION(buffer);
+
+        memory = gst_buffer_peek_memory(frame, 0);
+    }
+
+    if (!gst_nemo_test_egl_allocator_upload(self->allocator, (GstNemoTestEglMemory *) memory)) {
+        gst_buffer_unref(frame);
+        GST_ELEMENT_ERROR(self, RESOURCE, WRITE, ("Failed to upload a frame"), (NULL));
+        return GST_FLOW_ERROR;
+    }
+
+    g_signal_emit(self, gst_nemo_test_egl_sink_signals[SIGNAL_SHOW_FRAME], 0, frame);
+
+    gst_buffer_unref(frame);
+
+    return GST_FLOW_OK;
+}
+
+static void
+gst_nemo_test_egl_sink_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec)
+{
+    GstNemoTestEglSink *self = GST_NEMO_TEST_EGL_SINK(object);
+
+    switch (prop_id) {
+    case PROP_EGL_DISPLAY:
+        self->display = g_value_get_pointer(value);
+        break;
+    case PROP_BUFFER_COUNT:
+        self->buffer_count = g_value_get_uint(value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+gst_nemo_test_egl_sink_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+    GstNemoTestEglSink *self = GST_NEMO_TEST_EGL_SINK(object);
+
+    switch (prop_id) {
+    case PROP_EGL_DISPLAY:
+        g_value_set_pointer(value, self->display);
+        break;
+    case PROP_BUFFER_COUNT:
+        g_value_set_uint(value, self->buffer_count);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+gst_nemo_test_egl_sink_finalize(GObject *object)
+{
+    GstNemoTestEglSink *self = GST_NEMO_TEST_EGL_SINK(object);
+
+    gst_nemo_test_egl_sink_release_pool(self);
+
+    if (self->allocator) {
+        gst_object_unref(self->allocator);
+    }
+
+    G_OBJECT_CLASS(gst_nemo_test_egl_sink_parent_class)->finalize(object);
+}
+
+static void
+gst_nemo_test_egl_sink_class_init(GstNemoTestEglSinkClass *klass)
+{
+    GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+    GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+    GstBaseSinkClass *basesink_class = GST_BASE_SINK_CLASS(klass);
+    GstVideoSinkClass *videosink_class = GST_VIDEO_SINK_CLASS(klass);
+
+    GST_DEBUG_CATEGORY_INIT(gst_nemo_test_egl_sink_debug, "nemotesteglsink", 0, "Test EGL sink");
+
+    gobject_class->set_property = gst_nemo_test_egl_sink_set_property;
+    gobject_class->get_property = gst_nemo_test_egl_sink_get_property;
+    gobject_class->finalize = gst_nemo_test_egl_sink_finalize;
+
+    g_object_class_install_property(gobject_class, PROP_EGL_DISPLAY,
+            g_param_spec_pointer("egl-display", "EGL display",
+                    "The EGL display images are created for",
+                    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+    g_object_class_install_property(gobject_class, PROP_BUFFER_COUNT,
+            g_param_spec_uint("buffer-count", "Buffer count",
+                    "The number of buffers in the pool proposed upstream",
+                    2, 64, DEFAULT_BUFFER_COUNT,
+                    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+    gst_nemo_test_egl_sink_signals[SIGNAL_SHOW_FRAME] = g_signal_new("show-frame",
+            G_TYPE_FROM_CLASS(klass), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
+            G_TYPE_NONE, 1, GST_TYPE_BUFFER | G_SIGNAL_TYPE_STATIC_SCOPE);
+    gst_nemo_test_egl_sink_signals[SIGNAL_BUFFERS_INVALIDATED] = g_signal_new("buffers-invalidated",
+            G_TYPE_FROM_CLASS(klass), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
+            G_TYPE_NONE, 0);
+
+    gst_element_class_set_static_metadata(element_class,
+            "Test EGL sink", "Sink/Video",
+            "Software stand in for droideglsink backed by system memory",
+            "Open Mobile Platform LLC");
+    gst_element_class_add_static_pad_template(element_class, &gst_nemo_test_egl_sink_template);
+
+    basesink_class->start = gst_nemo_test_egl_sink_start;
+    basesink_class->stop = gst_nemo_test_egl_sink_stop;
+    basesink_class->set_caps = gst_nemo_test_egl_sink_set_caps;
+    basesink_class->propose_allocation = gst_nemo_test_egl_sink_propose_allocation;
+
+    videosink_class->show_frame = gst_nemo_test_egl_sink_show_frame;
+}
+
+static void
+gst_nemo_test_egl_sink_init(GstNemoTestEglSink *self)
+{
+    self->display = EGL_NO_DISPLAY;
+    self->buffer_count = DEFAULT_BUFFER_COUNT;
+    self->allocator = NULL;
+    self->pool = NULL;
+    gst_video_info_init(&self->info);
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef GST_NEMO_TEST_EGL_SINK_H
+#define GST_NEMO_TEST_EGL_SINK_H
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideosink.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A stand in for droideglsink backed by system memory, for running the video texture
+ * backend on machines without Android hardware abstraction, such as Mesa llvmpipe
+ * with a surfaceless EGL display.
+ *
+ * It has the same egl-display property and show-frame and buffers-invalidated signals
+ * as droideglsink, and its memories implement the NemoGstEglImageMemory interface.
+ * Frames are uploaded into a GL texture owned by a private EGL context on the
+ * streaming thread and the EGLImages handed out are created from those textures.
+ */
+
+#define GST_TYPE_NEMO_TEST_EGL_SINK \
+    (gst_nemo_test_egl_sink_get_type())
+#define GST_NEMO_TEST_EGL_SINK(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_NEMO_TEST_EGL_SINK, GstNemoTestEglSink))
+
+typedef struct _GstNemoTestEglSink GstNemoTestEglSink;
+typedef struct _GstNemoTestEglSinkClass GstNemoTestEglSinkClass;
+typedef struct _GstNemoTestEglAllocator GstNemoTestEglAllocator;
+
+struct _GstNemoTestEglSink
+{
+    GstVideoSink parent;
+
+    EGLDisplay display;
+    guint buffer_count;
+    GstVideoInfo info;
+    GstNemoTestEglAllocator *allocator;
+    GstBufferPool *pool;
+};
+
+struct _GstNemoTestEglSinkClass
+{
+    GstVideoSinkClass parent_class;
+};
+
+GType gst_nemo_test_egl_sink_get_type(void);
+
+G_END_DECLS
+
+#endif
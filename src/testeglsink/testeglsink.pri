@@ -0,0 +1,20 @@
+# The sink sources, shared by the plugin and the benchmarks registering it statically.
+
+CONFIG += link_pkgconfig
+
+PKGCONFIG += \
+        egl \
+        glesv2 \
+        gstreamer-1.0 \
+        gstreamer-video-1.0 \
+        nemo-gstreamer-interfaces-1.0
+
+DEFINES += MESA_EGL_NO_X11_HEADERS
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+        $$PWD/gstnemotesteglsink.c
+
+HEADERS += \
+        $$PWD/gstnemotesteglsink.h
@@ -0,0 +1,22 @@
+TEMPLATE = lib
+TARGET = gstnemotesteglsink
+
+CONFIG += plugin
+CONFIG -= qt
+
+include(testeglsink.pri)
+
+# The version of the package, as the spec has it.
+SPEC_LINES = $$cat($$PWD/../../rpm/nemo-qtmultimedia-plugins-gstvideotexturebackend.spec, lines)
+PACKAGE_VERSION = $$find(SPEC_LINES, ^Version:)
+PACKAGE_VERSION = $$replace(PACKAGE_VERSION, ^Version:\\s*, )
+
+DEFINES += \
+        PACKAGE=\\\"nemo-qtmultimedia-plugins\\\" \
+        VERSION=\\\"$$PACKAGE_VERSION\\\"
+
+SOURCES += \
+        plugin.c
+
+# Not installed, only meant for running the backend on machines without droideglsink:
+#   GST_PLUGIN_PATH=<build dir>/src/testeglsink QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_SINK=nemotesteglsink
@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+
+#include "asyncfilterchain.h"
+
+#include <QCoreApplication>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+
+namespace NemoVideoBackend {
+
+FilterStatisticsEvent::FilterStatisticsEvent(quint64 filtered, quint64 dropped, qreal latency)
+    : QEvent(eventType())
+    , framesFiltered(filtered)
+    , framesDropped(dropped)
+    , latency(latency)
+{
+}
+
+QEvent::Type FilterStatisticsEvent::eventType()
+{
+    static const QEvent::Type type = QEvent::Type(QEvent::registerEventType());
+    return type;
+}
+
+class AsyncFilterChain::Worker : public QRunnable
+{
+public:
+    explicit Worker(AsyncFilterChain *chain) : m_chain(chain) {}
+
+    void run() override { m_chain->drain(); }
+
+private:
+    AsyncFilterChain * const m_chain;
+};
+
+class AsyncFilterChain::StageWorker : public QRunnable
+{
+public:
+    StageWorker(Stage *stage, QVideoFilterRunnable::RunFlags flags, QSemaphore *done)
+        : m_stage(stage), m_flags(flags), m_done(done) {}
+
+    void run() override
+    {
+        runStage(m_stage, m_flags);
+        m_done->release();
+    }
+
+private:
+    Stage * const m_stage;
+    const QVideoFilterRunnable::RunFlags m_flags;
+    QSemaphore * const m_done;
+};
+
+AsyncFilterChain::AsyncFilterChain(int capacity, DropPolicy dropPolicy, bool parallel)
+    : m_capacity(qMax(1, capacity))
+    , m_dropPolicy(dropPolicy)
+    , m_parallel(parallel)
+    , m_running(false)
+{
+    // The worker draining the queue takes a thread from the pool itself.
+    m_pool.setMaxThreadCount(parallel ? qMax(2, QThread::idealThreadCount() + 1) : 1);
+}
+
+AsyncFilterChain::~AsyncFilterChain()
+{
+    flush();
+    m_pool.waitForDone();
+}
+
+void AsyncFilterChain::push(const QVector<Stage> &stages)
+{
+    QMutexLocker locker(&m_mutex);
+
+    const Frame frame = { stages, now() };
+
+    if (int(m_frames.size()) >= m_capacity) {
+        if (m_dropPolicy == DropNewest) {
+            drop(frame);
+            return;
+        }
+        drop(m_frames.front());
+        m_frames.pop_front();
+    }
+    m_frames.push_back(frame);
+
+    if (!m_running) {
+        m_running = true;
+        m_pool.start(new Worker(this));
+    }
+}
+
+bool AsyncFilterChain::rejectsNext()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_dropPolicy == DropNewest && int(m_frames.size()) >= m_capacity;
+}
+
+void AsyncFilterChain::skip(const QVector<Stage> &stages)
+{
+    QMutexLocker locker(&m_mutex);
+
+    const Frame frame = { stages, now() };
+    drop(frame);
+}
+
+void AsyncFilterChain::flush()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_frames.clear();
+    while (m_running) {
+        m_idle.wait(&m_mutex);
+    }
+    m_statistics.clear();
+}
+
+void AsyncFilterChain::drain()
+{
+    QMutexLocker locker(&m_mutex);
+
+    while (!m_frames.empty()) {
+        Frame frame = m_frames.front();
+        m_frames.pop_front();
+
+        locker.unlock();
+
+        run(frame.stages, m_parallel ? &m_pool : nullptr);
+
+        locker.relock();
+        for (const Stage &stage : frame.stages) {
+            const qreal latency = qreal(stage.finished - frame.queued) / 1000000;
+
+            Statistics &statistics = m_statistics[stage.filter];
+            statistics.latency = statistics.filtered == 0
+                    ? latency
+                    : statistics.latency + (latency - statistics.latency) / 8;
+            ++statistics.filtered;
+            post(stage.filter, statistics);
+        }
+        locker.unlock();
+
+        // Release the frame copies before picking up the next frame.
+        frame.stages.clear();
+
+        locker.relock();
+    }
+
+    m_running = false;
+    m_idle.wakeAll();
+}
+
+void AsyncFilterChain::run(QVector<Stage> &stages, QThreadPool *pool)
+{
+    const int count = stages.count();
+    Stage * const data = stages.data();
+
+    if (!pool || count < 2) {
+        for (int i = 0; i < count; ++i) {
+            runStage(&data[i], i == count - 1 ? QVideoFilterRunnable::LastInChain : QVideoFilterRunnable::RunFlags());
+        }
+        return;
+    }
+
+    QSemaphore done;
+    for (int i = 1; i < count; ++i) {
+        pool->start(new StageWorker(
+                &data[i], i == count - 1 ? QVideoFilterRunnable::LastInChain : QVideoFilterRunnable::RunFlags(), &done));
+    }
+    runStage(&data[0], QVideoFilterRunnable::RunFlags());
+    done.acquire(count - 1);
+}
+
+void AsyncFilterChain::runStage(Stage *stage, QVideoFilterRunnable::RunFlags flags)
+{
+    stage->runnable->run(&stage->frame, stage->format, flags);
+    stage->finished = now();
+}
+
+qint64 AsyncFilterChain::now()
+{
+    static const QElapsedTimer clock = [] {
+        QElapsedTimer clock;
+        clock.start();
+        return clock;
+    }();
+    return clock.nsecsElapsed();
+}
+
+void AsyncFilterChain::drop(const Frame &frame)
+{
+    for (const Stage &stage : frame.stages) {
+        Statistics &statistics = m_statistics[stage.filter];
+        ++statistics.dropped;
+        post(stage.filter, statistics);
+    }
+}
+
+void AsyncFilterChain::post(QAbstractVideoFilter *filter, const Statistics &statistics)
+{
+    QCoreApplication::postEvent(
+                filter, new FilterStatisticsEvent(statistics.filtered, statistics.dropped, statistics.latency));
+}
+
+MappedVideoBuffer::MappedVideoBuffer(uchar *data, int numBytes, int bytesPerLine)
+    : QAbstractVideoBuffer(NoHandle)
+    , m_data(data)
+    , m_numBytes(numBytes)
+    , m_bytesPerLine(bytesPerLine)
+    , m_mapMode(NotMapped)
+{
+}
+
+QAbstractVideoBuffer::MapMode MappedVideoBuffer::mapMode() const
+{
+    return m_mapMode;
+}
+
+uchar *MappedVideoBuffer::map(MapMode mode, int *numBytes, int *bytesPerLine)
+{
+    if (m_mapMode != NotMapped || mode != ReadOnly) {
+        return nullptr;
+    }
+    m_mapMode = mode;
+
+    if (numBytes)
+        *numBytes = m_numBytes;
+
+    if (bytesPerLine)
+        *bytesPerLine = m_bytesPerLine;
+
+    return m_data;
+}
+
+void MappedVideoBuffer::unmap()
+{
+    m_mapMode = NotMapped;
+}
+
+} //namespace NemoVideoBackend
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+
+#ifndef ASYNCFILTERCHAIN_H
+#define ASYNCFILTERCHAIN_H
+
+#include <QAbstractVideoBuffer>
+#include <QAbstractVideoFilter>
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QHash>
+#include <QMutex>
+#include <QThreadPool>
+#include <QVector>
+#include <QVideoFrame>
+#include <QVideoSurfaceFormat>
+#include <QWaitCondition>
+
+#include <deque>
+
+namespace NemoVideoBackend {
+
+/**
+ * @brief The FilterStatisticsEvent class
+ * Posted to a filter object after its runnable ran asynchronously, or a frame
+ * for it was dropped. The backend filters the events of its filters and
+ * exposes the counters as dynamic properties.
+ */
+class FilterStatisticsEvent : public QEvent
+{
+public:
+    FilterStatisticsEvent(quint64 filtered, quint64 dropped, qreal latency);
+
+    static QEvent::Type eventType();
+
+    const quint64 framesFiltered;
+    const quint64 framesDropped;
+    const qreal latency;    // milliseconds from queuing the frame to the runnable returning
+};
+
+/**
+ * @brief The AsyncFilterChain class
+ * Runs the video filter runnables on a worker thread pool instead of the render
+ * thread. The render thread pushes copies of the read back frames into a bounded
+ * queue and carries on, when the queue is full either the oldest queued frame or
+ * the new one is dropped. Frames are filtered in order, one at a time, so a
+ * runnable is never run concurrently with itself. What the runnables return is
+ * ignored.
+ * In parallel the runnables of a frame run concurrently on the pool, sharing
+ * the frame, and the next frame is picked up once all of them have returned.
+ */
+class AsyncFilterChain
+{
+public:
+    enum DropPolicy {
+        DropOldest,
+        DropNewest
+    };
+
+    struct Stage
+    {
+        QAbstractVideoFilter *filter;
+        QVideoFilterRunnable *runnable;
+        QVideoFrame frame;
+        QVideoSurfaceFormat format;
+        qint64 finished;
+    };
+
+    AsyncFilterChain(int capacity, DropPolicy dropPolicy, bool parallel);
+    ~AsyncFilterChain();
+
+    // Runs the runnables of a frame, concurrently on the pool if there is one, and returns
+    // once all of them have. The calling thread runs the first.
+    static void run(QVector<Stage> &stages, QThreadPool *pool);
+
+    int capacity() const { return m_capacity; }
+    DropPolicy dropPolicy() const { return m_dropPolicy; }
+
+    void push(const QVector<Stage> &stages);
+
+    // Whether a frame pushed now would be dropped on arrival, so it needn't be read back.
+    bool rejectsNext();
+    // Counts a frame the filters of stages never got as dropped, without queuing it.
+    void skip(const QVector<Stage> &stages);
+
+    // Drops the queued frames and waits for the running runnables to return, after which
+    // runnables can be deleted. Resets the statistics.
+    void flush();
+
+private:
+    class Worker;
+    class StageWorker;
+
+    struct Frame
+    {
+        QVector<Stage> stages;
+        qint64 queued;
+    };
+
+    struct Statistics
+    {
+        quint64 filtered = 0;
+        quint64 dropped = 0;
+        qreal latency = 0;
+    };
+
+    void drain();
+    void drop(const Frame &frame);
+    void post(QAbstractVideoFilter *filter, const Statistics &statistics);
+    static void runStage(Stage *stage, QVideoFilterRunnable::RunFlags flags);
+    static qint64 now();
+
+    QThreadPool m_pool;
+    QMutex m_mutex;
+    QWaitCondition m_idle;
+    std::deque<Frame> m_frames;
+    QHash<QAbstractVideoFilter *, Statistics> m_statistics;
+    const int m_capacity;
+    const DropPolicy m_dropPolicy;
+    const bool m_parallel;
+    bool m_running;
+};
+
+/**
+ * @brief The MappedVideoBuffer class
+ * Read only view of memory mapped elsewhere, so filters running in parallel can
+ * share a frame read back once on the render thread. The memory must stay mapped
+ * for as long as the buffer is.
+ */
+class MappedVideoBuffer : public QAbstractVideoBuffer
+{
+public:
+    MappedVideoBuffer(uchar *data, int numBytes, int bytesPerLine);
+
+    MapMode mapMode() const override;
+    uchar *map(MapMode mode, int *numBytes, int *bytesPerLine) override;
+    void unmap() override;
+
+private:
+    uchar * const m_data;
+    const int m_numBytes;
+    const int m_bytesPerLine;
+    MapMode m_mapMode;
+};
+
+} //namespace NemoVideoBackend
+#endif // ASYNCFILTERCHAIN_H
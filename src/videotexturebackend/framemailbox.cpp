@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "framemailbox.h"
+
+namespace NemoVideoBackend {
+
+FrameMailbox::FrameMailbox()
+    : m_shared(1)
+    , m_back(0)
+    , m_front(2)
+{
+}
+
+FrameMailbox::~FrameMailbox()
+{
+    clear();
+}
+
+bool FrameMailbox::publish(const QueuedFrame &frame)
+{
+    QueuedFrame &slot = m_slots[m_back];
+    slot = frame;
+    if (slot.buffer) {
+        gst_buffer_ref(slot.buffer);
+    }
+
+    // Hand our slot over and get the shared one back. The consumer empties the slots
+    // it takes, so the one we get back only holds a frame if it was never consumed.
+    const int previous = m_shared.fetchAndStoreOrdered(m_back | FreshFlag);
+    m_back = previous & IndexMask;
+
+    releaseFrame(&m_slots[m_back]);
+
+    return previous & FreshFlag;
+}
+
+bool FrameMailbox::take(QueuedFrame *frame)
+{
+    if (!(m_shared.loadAcquire() & FreshFlag)) {
+        return false;
+    }
+
+    // Only the consumer clears the flag, so the shared slot is still fresh here.
+    m_front = m_shared.fetchAndStoreOrdered(m_front) & IndexMask;
+
+    *frame = m_slots[m_front];
+    m_slots[m_front] = QueuedFrame();
+
+    return true;
+}
+
+void FrameMailbox::clear()
+{
+    for (QueuedFrame &frame : m_slots) {
+        releaseFrame(&frame);
+    }
+    m_shared.store(m_shared.load() & IndexMask);
+}
+
+void FrameMailbox::releaseFrame(QueuedFrame *frame)
+{
+    if (frame->buffer) {
+        gst_buffer_unref(frame->buffer);
+    }
+    *frame = QueuedFrame();
+}
+
+} //namespace NemoVideoBackend
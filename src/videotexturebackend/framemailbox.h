@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef FRAMEMAILBOX_H
+#define FRAMEMAILBOX_H
+
+#include <QAtomicInt>
+
+#include <gst/gst.h>
+
+namespace NemoVideoBackend {
+
+struct QueuedFrame
+{
+    GstBuffer *buffer = nullptr;
+    GstClockTime runningTime = GST_CLOCK_TIME_NONE;
+    quint64 sequence = 0;   // FrameTrace record, 0 if not traced
+};
+
+/**
+ * @brief The FrameMailbox class
+ * Wait-free single producer, single consumer triple buffer handing frames
+ * from the GStreamer streaming thread to the QML render thread.
+ * The producer and the consumer each own one slot, the third one is shared
+ * and exchanged atomically together with a flag telling whether it holds
+ * a frame the consumer hasn't taken yet. Neither side ever waits for the other.
+ */
+class FrameMailbox
+{
+public:
+    FrameMailbox();
+    ~FrameMailbox();
+
+    // Producer side. Takes a reference to the frame's buffer, which may be null to clear the
+    // output. Returns true if this replaced a frame the consumer never took.
+    bool publish(const QueuedFrame &frame);
+
+    // Consumer side. Returns false if nothing was published since the last call,
+    // otherwise moves the latest frame into frame and the caller owns its buffer.
+    bool take(QueuedFrame *frame);
+
+    // Drops all frames. Neither side may be active while this is called.
+    void clear();
+
+private:
+    enum {
+        IndexMask = 0x3,
+        FreshFlag = 0x4
+    };
+
+    static void releaseFrame(QueuedFrame *frame);
+
+    QueuedFrame m_slots[3];
+    QAtomicInt m_shared;
+    int m_back;     // owned by the producer
+    int m_front;    // owned by the consumer
+};
+
+} //namespace NemoVideoBackend
+#endif // FRAMEMAILBOX_H
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "framequeue.h"
+
+namespace NemoVideoBackend {
+
+FrameQueue::FrameQueue(int capacity)
+    : m_frames(qMax(1, capacity))
+    , m_head(0)
+    , m_tail(0)
+    , m_flushed(0)
+{
+}
+
+FrameQueue::~FrameQueue()
+{
+    clear();
+}
+
+int FrameQueue::capacity() const
+{
+    return m_frames.count();
+}
+
+bool FrameQueue::isEmpty() const
+{
+    return m_tail.loadAcquire() == m_head.load();
+}
+
+bool FrameQueue::push(const QueuedFrame &frame)
+{
+    const quint64 tail = m_tail.load();
+
+    // The consumer empties a slot before it moves the head past it.
+    if (tail - m_head.loadAcquire() == quint64(m_frames.count())) {
+        return true;
+    }
+
+    QueuedFrame &queued = slot(tail);
+    queued = frame;
+    if (queued.buffer) {
+        gst_buffer_ref(queued.buffer);
+    }
+    m_tail.storeRelease(tail + 1);
+
+    return false;
+}
+
+void FrameQueue::flush()
+{
+    m_flushed.storeRelease(m_tail.load());
+}
+
+bool FrameQueue::take(QueuedFrame *frame, GstClockTime presentationTime, GstClockTime tolerance, int *dropped)
+{
+    // The flush position is published after the frames before it, so the tail is never behind it.
+    const quint64 flushed = m_flushed.loadAcquire();
+    const quint64 tail = m_tail.loadAcquire();
+    quint64 head = m_head.load();
+
+    for (; head < flushed; ++head) {
+        QueuedFrame &queued = slot(head);
+        if (queued.buffer) {
+            gst_buffer_unref(queued.buffer);
+        }
+        queued = QueuedFrame();
+    }
+
+    // Running times only grow within a segment, but a frame without one, like the null
+    // frame clearing the output, is due at once and makes everything before it obsolete.
+    quint64 due = tail;
+    for (quint64 i = head; i < tail; ++i) {
+        const QueuedFrame &queued = slot(i);
+        if (!GST_CLOCK_TIME_IS_VALID(presentationTime)
+                || !GST_CLOCK_TIME_IS_VALID(queued.runningTime)
+                || queued.runningTime <= presentationTime + tolerance) {
+            due = i;
+        }
+    }
+
+    int released = 0;
+    if (due != tail) {
+        for (; head < due; ++head) {
+            QueuedFrame &queued = slot(head);
+            if (queued.buffer) {
+                gst_buffer_unref(queued.buffer);
+                ++released;
+            }
+            queued = QueuedFrame();
+        }
+
+        *frame = slot(head);
+        slot(head) = QueuedFrame();
+        ++head;
+    }
+
+    m_head.storeRelease(head);
+
+    if (dropped) {
+        *dropped = released;
+    }
+
+    return due != tail;
+}
+
+void FrameQueue::clear()
+{
+    for (QueuedFrame &frame : m_frames) {
+        if (frame.buffer) {
+            gst_buffer_unref(frame.buffer);
+        }
+        frame = QueuedFrame();
+    }
+    m_head.store(0);
+    m_tail.store(0);
+    m_flushed.store(0);
+}
+
+} //namespace NemoVideoBackend
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef FRAMEQUEUE_H
+#define FRAMEQUEUE_H
+
+#include <QAtomicInteger>
+#include <QVector>
+
+#include "framemailbox.h"
+
+namespace NemoVideoBackend {
+
+/**
+ * @brief The FrameQueue class
+ * Wait-free single producer, single consumer ring of frames ordered by running
+ * time, used instead of the FrameMailbox when frames should be presented
+ * according to their time stamps. The sink hands frames over ahead of their
+ * running time and the consumer picks the newest frame due at the predicted
+ * presentation time, dropping the older ones before they are ever imported.
+ * The producer only advances the tail and the consumer the head, a full queue
+ * refuses the new frame. Frames are only ever released by the side owning them.
+ */
+class FrameQueue
+{
+public:
+    explicit FrameQueue(int capacity);
+    ~FrameQueue();
+
+    int capacity() const;
+
+    // Consumer side.
+    bool isEmpty() const;
+
+    // Producer side. Takes a reference to the frame's buffer, which may be null to clear the
+    // output. Returns true if the queue was full and the frame was dropped instead.
+    bool push(const QueuedFrame &frame);
+
+    // Producer side. Frames pushed so far are released by the consumer's next take().
+    void flush();
+
+    // Consumer side. Returns false if no queued frame is due at presentationTime, otherwise
+    // moves the newest due frame into frame and the caller owns its buffer. Frames queued
+    // before it are released and counted in dropped. A frame is due if its running time is
+    // at most tolerance after presentationTime, every frame is due if that is unknown.
+    bool take(QueuedFrame *frame, GstClockTime presentationTime, GstClockTime tolerance, int *dropped);
+
+    // Drops all frames. Neither side may be active while this is called.
+    void clear();
+
+private:
+    QueuedFrame &slot(quint64 index) { return m_frames[int(index % m_frames.count())]; }
+
+    QVector<QueuedFrame> m_frames;
+    // positions only ever grow, the slot is the position modulo the capacity
+    QAtomicInteger<quint64> m_head;     // advanced by the consumer
+    QAtomicInteger<quint64> m_tail;     // advanced by the producer
+    QAtomicInteger<quint64> m_flushed;  // frames before this position are stale
+};
+
+} //namespace NemoVideoBackend
+#endif // FRAMEQUEUE_H
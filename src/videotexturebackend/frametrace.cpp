@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "frametrace.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+namespace NemoVideoBackend {
+
+namespace {
+enum ThreadId {
+    StreamingThread = 1,
+    RenderThread = 2
+};
+
+QJsonObject traceEvent(const char *name, ThreadId thread, GstClockTime start, GstClockTime end, quint64 sequence)
+{
+    QJsonObject args;
+    args.insert(QStringLiteral("frame"), double(sequence));
+
+    QJsonObject event;
+    event.insert(QStringLiteral("name"), QLatin1String(name));
+    event.insert(QStringLiteral("ph"), QStringLiteral("X"));
+    event.insert(QStringLiteral("pid"), double(QCoreApplication::applicationPid()));
+    event.insert(QStringLiteral("tid"), thread);
+    event.insert(QStringLiteral("ts"), double(start) / GST_USECOND);
+    event.insert(QStringLiteral("dur"), double(end - start) / GST_USECOND);
+    event.insert(QStringLiteral("args"), args);
+    return event;
+}
+}
+
+FrameTrace::FrameTrace(int capacity)
+    : m_records(new Record[qMax(1, capacity)])
+    , m_capacity(qMax(1, capacity))
+    , m_nextSequence(0)
+{
+    for (int i = 0; i < m_capacity; ++i) {
+        m_records[i].sequence.store(0);
+    }
+}
+
+FrameTrace::~FrameTrace()
+{
+}
+
+quint64 FrameTrace::begin(GstClockTime pts)
+{
+    const quint64 sequence = ++m_nextSequence;
+    Record &record = m_records[sequence % m_capacity];
+
+    // Invalidate the record before reusing it so stale stamps for it are ignored. Only a full
+    // barrier keeps the resets below from becoming visible ahead of it.
+    record.sequence.fetchAndStoreOrdered(0);
+    record.pts.store(pts);
+    for (QAtomicInteger<quint64> &stamp : record.stamps) {
+        stamp.store(GST_CLOCK_TIME_NONE);
+    }
+    record.stamps[Arrival].store(now());
+    record.sequence.storeRelease(sequence);
+
+    return sequence;
+}
+
+void FrameTrace::stamp(quint64 sequence, Stage stage, GstClockTime time)
+{
+    if (sequence == 0) {
+        return;
+    }
+
+    Record &record = m_records[sequence % m_capacity];
+    if (record.sequence.loadAcquire() != sequence) {
+        return;
+    }
+    // A full barrier, so the check below can't be done ahead of the store.
+    record.stamps[stage].fetchAndStoreOrdered(time);
+
+    // begin() may have reused the record between the check and the store, take the stamp back
+    // unless the new frame already replaced it.
+    if (record.sequence.loadAcquire() != sequence) {
+        record.stamps[stage].testAndSetOrdered(time, GST_CLOCK_TIME_NONE);
+    }
+}
+
+bool FrameTrace::write(QIODevice *device) const
+{
+    static const struct {
+        const char *name;
+        ThreadId thread;
+        Stage start;
+        Stage end;
+    } spans[] = {
+        { "queued", StreamingThread, Arrival, Pickup },
+        { "import", RenderThread, ImportStart, ImportEnd },
+        { "filters", RenderThread, FilterStart, FilterEnd },
+        { "presented", RenderThread, Pickup, Swap }
+    };
+
+    QJsonArray events;
+
+    for (int i = 0; i < m_capacity; ++i) {
+        const Record &record = m_records[i];
+        const quint64 sequence = record.sequence.loadAcquire();
+        if (sequence == 0) {
+            continue;
+        }
+
+        const GstClockTime pts = record.pts.load();
+        GstClockTime stamps[StageCount];
+        for (int stage = 0; stage < StageCount; ++stage) {
+            stamps[stage] = record.stamps[stage].loadAcquire();
+        }
+        if (record.sequence.loadAcquire() != sequence) {
+            // Reused while it was being read.
+            continue;
+        }
+
+        if (!GST_CLOCK_TIME_IS_VALID(stamps[Pickup])) {
+            // Never picked up by the render thread, replaced by a newer frame.
+            QJsonObject event = traceEvent("dropped", StreamingThread, stamps[Arrival], stamps[Arrival], sequence);
+            event.insert(QStringLiteral("ph"), QStringLiteral("i"));
+            event.remove(QStringLiteral("dur"));
+            events.append(event);
+        }
+
+        for (const auto &span : spans) {
+            if (GST_CLOCK_TIME_IS_VALID(stamps[span.start]) && GST_CLOCK_TIME_IS_VALID(stamps[span.end])) {
+                QJsonObject event = traceEvent(span.name, span.thread, stamps[span.start], stamps[span.end], sequence);
+                if (span.start == Arrival && GST_CLOCK_TIME_IS_VALID(pts)) {
+                    QJsonObject args = event.value(QStringLiteral("args")).toObject();
+                    args.insert(QStringLiteral("pts"), double(pts) / GST_USECOND);
+                    event.insert(QStringLiteral("args"), args);
+                }
+                events.append(event);
+            }
+        }
+    }
+
+    QJsonObject trace;
+    trace.insert(QStringLiteral("traceEvents"), events);
+    trace.insert(QStringLiteral("displayTimeUnit"), QStringLiteral("ms"));
+
+    return device->write(QJsonDocument(trace).toJson(QJsonDocument::Compact)) != -1;
+}
+
+bool FrameTrace::write(const QString &fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Failed to open frame trace file" << fileName << file.errorString();
+        return false;
+    }
+    return write(&file);
+}
+
+} //namespace NemoVideoBackend
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef FRAMETRACE_H
+#define FRAMETRACE_H
+
+#include <QAtomicInteger>
+#include <QString>
+
+#include <gst/gst.h>
+
+#include <memory>
+
+QT_FORWARD_DECLARE_CLASS(QIODevice)
+
+namespace NemoVideoBackend {
+
+/**
+ * @brief The FrameTrace class
+ * Preallocated ring of per frame time stamps, from the buffer arriving on the
+ * streaming thread to the window swapping the frame to the screen, which can be
+ * written out in the Chrome trace event format. The streaming thread begins a
+ * record, the render thread stamps the later stages. Nothing locks; a stamp
+ * checks the record's sequence before and after it is stored and is taken back
+ * if the record was reused in between, and write() skips records that change
+ * while it reads them.
+ */
+class FrameTrace
+{
+public:
+    enum Stage {
+        Arrival,        // show_frame()
+        Pickup,         // updatePaintNode()
+        ImportStart,    // GStreamerVideoTexture::updateTexture() EGLImage lookup
+        ImportEnd,      // texture bound
+        FilterStart,    // video filter runnables
+        FilterEnd,
+        Swap,           // QQuickWindow::frameSwapped()
+        StageCount
+    };
+
+    explicit FrameTrace(int capacity);
+    ~FrameTrace();
+
+    static GstClockTime now() { return gst_util_get_timestamp(); }
+
+    // Producer side, returns the sequence number identifying the record.
+    quint64 begin(GstClockTime pts);
+    void stamp(quint64 sequence, Stage stage, GstClockTime time = now());
+
+    bool write(QIODevice *device) const;
+    bool write(const QString &fileName) const;
+
+private:
+    struct Record
+    {
+        QAtomicInteger<quint64> sequence;
+        QAtomicInteger<quint64> pts;
+        QAtomicInteger<quint64> stamps[StageCount];
+    };
+
+    std::unique_ptr<Record[]> m_records;
+    const int m_capacity;
+    quint64 m_nextSequence;     // producer only
+};
+
+} //namespace NemoVideoBackend
+#endif // FRAMETRACE_H
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+
+#include "memorypressure.h"
+
+#include <QCoreApplication>
+#include <QLoggingCategory>
+#include <QSocketNotifier>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace NemoVideoBackend {
+
+namespace {
+Q_LOGGING_CATEGORY(Retention, "org.sailfishos.multimedia.egltexture.retention", QtWarningMsg)
+
+// The kernel accepts unprivileged triggers with windows of whole multiples of two seconds.
+const int c_window = 2000000;
+}
+
+MemoryPressure *MemoryPressure::instance()
+{
+    static MemoryPressure *pressure = nullptr;
+    if (!pressure) {
+        pressure = new MemoryPressure;
+        pressure->setParent(QCoreApplication::instance());
+    }
+    return pressure;
+}
+
+MemoryPressure::MemoryPressure()
+    : m_notifier(nullptr)
+    , m_fd(-1)
+{
+    const int threshold = qEnvironmentVariableIsSet("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_MEMORY_PRESSURE")
+            ? qEnvironmentVariableIntValue("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_MEMORY_PRESSURE")
+            : 150;
+    if (threshold <= 0) {
+        return;
+    }
+
+    m_fd = ::open("/proc/pressure/memory", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (m_fd < 0) {
+        return;
+    }
+
+    const QByteArray trigger = "some " + QByteArray::number(qMin(threshold * 1000, c_window))
+            + ' ' + QByteArray::number(c_window);
+    if (::write(m_fd, trigger.constData(), trigger.size() + 1) < 0) {
+        qCDebug(Retention) << "no memory pressure trigger";
+        ::close(m_fd);
+        m_fd = -1;
+        return;
+    }
+
+    // Triggers are signalled as priority data.
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Exception, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &MemoryPressure::triggered);
+}
+
+MemoryPressure::~MemoryPressure()
+{
+    delete m_notifier;
+
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+void MemoryPressure::triggered()
+{
+    qCDebug(Retention) << "low memory";
+
+    emit low();
+}
+
+} //namespace NemoVideoBackend
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+
+#ifndef MEMORYPRESSURE_H
+#define MEMORYPRESSURE_H
+
+#include <QObject>
+
+QT_FORWARD_DECLARE_CLASS(QSocketNotifier)
+
+namespace NemoVideoBackend {
+
+/**
+ * @brief The MemoryPressure class
+ * Watches the kernel's memory pressure stall information and emits low() when
+ * tasks stall on memory for longer than a threshold, so caches can be trimmed
+ * before the system starts killing processes. Does nothing on kernels without
+ * PSI triggers. The threshold in milliseconds of stall per two seconds is set
+ * with QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_MEMORY_PRESSURE, zero disables it.
+ * GUI thread only.
+ */
+class MemoryPressure : public QObject
+{
+    Q_OBJECT
+public:
+    static MemoryPressure *instance();
+
+    ~MemoryPressure();
+
+signals:
+    void low();
+
+private slots:
+    void triggered();
+
+private:
+    MemoryPressure();
+
+    QSocketNotifier *m_notifier;
+    int m_fd;
+};
+
+} //namespace NemoVideoBackend
+#endif // MEMORYPRESSURE_H
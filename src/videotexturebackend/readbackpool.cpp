@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+
+#include "readbackpool.h"
+
+#include <QtDebug>
+
+#include <algorithm>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace NemoVideoBackend {
+
+namespace {
+// Transparent huge pages only back whole, aligned huge pages of a mapping.
+const size_t c_hugePageSize = 2 * 1024 * 1024;
+
+class PooledVideoBuffer : public QAbstractVideoBuffer
+{
+public:
+    PooledVideoBuffer(ReadbackPool *pool, uchar *data, int numBytes, int bytesPerLine)
+        : QAbstractVideoBuffer(NoHandle)
+        , m_pool(pool)
+        , m_data(data)
+        , m_numBytes(numBytes)
+        , m_bytesPerLine(bytesPerLine)
+        , m_mapMode(NotMapped)
+    {
+    }
+
+    ~PooledVideoBuffer()
+    {
+        m_pool->release(m_data);
+    }
+
+    MapMode mapMode() const override
+    {
+        return m_mapMode;
+    }
+
+    uchar *map(MapMode mode, int *numBytes, int *bytesPerLine) override
+    {
+        if (m_mapMode != NotMapped || mode == NotMapped) {
+            return nullptr;
+        }
+        m_mapMode = mode;
+
+        if (numBytes)
+            *numBytes = m_numBytes;
+
+        if (bytesPerLine)
+            *bytesPerLine = m_bytesPerLine;
+
+        return m_data;
+    }
+
+    void unmap() override
+    {
+        m_mapMode = NotMapped;
+    }
+
+private:
+    ReadbackPool * const m_pool;
+    uchar * const m_data;
+    const int m_numBytes;
+    const int m_bytesPerLine;
+    MapMode m_mapMode;
+};
+
+// The memory goes back to the pool with the last copy of the image.
+class ImageVideoBuffer : public QAbstractVideoBuffer
+{
+public:
+    explicit ImageVideoBuffer(const QImage &image)
+        : QAbstractVideoBuffer(NoHandle)
+        , m_image(image)
+        , m_mapMode(NotMapped)
+    {
+    }
+
+    MapMode mapMode() const override
+    {
+        return m_mapMode;
+    }
+
+    uchar *map(MapMode mode, int *numBytes, int *bytesPerLine) override
+    {
+        if (m_mapMode != NotMapped || mode != ReadOnly) {
+            return nullptr;
+        }
+        m_mapMode = mode;
+
+        if (numBytes)
+            *numBytes = m_image.byteCount();
+
+        if (bytesPerLine)
+            *bytesPerLine = m_image.bytesPerLine();
+
+        // Read only, so the image needn't detach.
+        return const_cast<uchar *>(m_image.constBits());
+    }
+
+    void unmap() override
+    {
+        m_mapMode = NotMapped;
+    }
+
+private:
+    const QImage m_image;
+    MapMode m_mapMode;
+};
+
+void releaseImage(void *data)
+{
+    ReadbackPool::instance()->release(static_cast<uchar *>(data));
+}
+}
+
+ReadbackPool *ReadbackPool::instance()
+{
+    // A few frames for each of the geometries filters ask for.
+    static ReadbackPool pool(8);
+    return &pool;
+}
+
+ReadbackPool::ReadbackPool(int capacity)
+    : m_capacity(capacity)
+    , m_hugePages(qEnvironmentVariableIntValue("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_HUGE_PAGES") != 0)
+{
+}
+
+ReadbackPool::~ReadbackPool()
+{
+    for (const auto &block : m_free) {
+        munmap(block.first, block.second);
+    }
+}
+
+int ReadbackPool::blockSize(int size) const
+{
+    static const int pageSize = sysconf(_SC_PAGESIZE);
+    const int alignment = m_hugePages ? int(c_hugePageSize) : pageSize;
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+// Maps size bytes, aligned to a huge page if they are to be backed by huge pages. The slack mapped
+// for the alignment is unmapped again, so the block can be unmapped with its own address and size.
+void *ReadbackPool::map(int size) const
+{
+#ifdef MADV_HUGEPAGE
+    if (m_hugePages) {
+        uchar * const data = static_cast<uchar *>(mmap(
+                    nullptr, size + c_hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (data == MAP_FAILED) {
+            return MAP_FAILED;
+        }
+
+        uchar * const aligned = reinterpret_cast<uchar *>(
+                    (reinterpret_cast<quintptr>(data) + c_hugePageSize - 1) & ~quintptr(c_hugePageSize - 1));
+        if (aligned > data) {
+            munmap(data, aligned - data);
+        }
+        munmap(aligned + size, data + size + c_hugePageSize - (aligned + size));
+
+        madvise(aligned, size, MADV_HUGEPAGE);
+        return aligned;
+    }
+#endif
+    return mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+}
+
+uchar *ReadbackPool::allocate(int size)
+{
+    size = blockSize(size);
+
+    QMutexLocker locker(&m_mutex);
+
+    const auto free = std::find_if(m_free.begin(), m_free.end(), [size](const std::pair<uchar *, int> &block) {
+        return block.second == size;
+    });
+    if (free != m_free.end()) {
+        uchar * const data = free->first;
+        m_free.erase(free);
+        m_used.emplace_back(data, size);
+        ++m_statistics.reuses;
+        return data;
+    }
+
+    void * const data = map(size);
+    if (data == MAP_FAILED) {
+        qWarning() << "Failed to map" << size << "bytes for a video frame";
+        return nullptr;
+    }
+
+    m_used.emplace_back(static_cast<uchar *>(data), size);
+    ++m_statistics.allocations;
+    m_statistics.bytes += size;
+    return static_cast<uchar *>(data);
+}
+
+void ReadbackPool::release(uchar *data)
+{
+    QMutexLocker locker(&m_mutex);
+
+    const auto used = std::find_if(m_used.begin(), m_used.end(), [data](const std::pair<uchar *, int> &block) {
+        return block.first == data;
+    });
+    if (used == m_used.end()) {
+        return;
+    }
+
+    m_free.push_back(*used);
+    m_used.erase(used);
+
+    if (int(m_free.size()) > m_capacity) {
+        munmap(m_free.front().first, m_free.front().second);
+        m_statistics.bytes -= m_free.front().second;
+        m_free.erase(m_free.begin());
+    }
+}
+
+QImage ReadbackPool::image(const QSize &size, QImage::Format format)
+{
+    const int bytesPerLine = size.width() * 4;
+    uchar * const data = allocate(bytesPerLine * size.height());
+    if (!data) {
+        return QImage(size, format);
+    }
+    return QImage(data, size.width(), size.height(), bytesPerLine, format, releaseImage, data);
+}
+
+QAbstractVideoBuffer *ReadbackPool::videoBuffer(int size, int bytesPerLine)
+{
+    uchar * const data = allocate(size);
+    return data ? new PooledVideoBuffer(this, data, size, bytesPerLine) : nullptr;
+}
+
+QAbstractVideoBuffer *ReadbackPool::videoBuffer(const QImage &image)
+{
+    return image.isNull() ? nullptr : new ImageVideoBuffer(image);
+}
+
+ReadbackPool::Statistics ReadbackPool::statistics() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_statistics;
+}
+
+} //namespace NemoVideoBackend
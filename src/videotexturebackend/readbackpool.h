@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+
+#ifndef READBACKPOOL_H
+#define READBACKPOOL_H
+
+#include <QAbstractVideoBuffer>
+#include <QImage>
+#include <QMutex>
+
+#include <utility>
+#include <vector>
+
+namespace NemoVideoBackend {
+
+/**
+ * @brief The ReadbackPool class
+ * Page aligned memory for the frames read back for video filters, reused from
+ * frame to frame rather than allocated and page faulted in anew each time.
+ * Blocks come back to the pool when the last image or video frame using them
+ * is gone, the pool keeps a few of them around and lets the oldest go, so the
+ * blocks of an old resolution are soon unmapped. Blocks can be backed by
+ * transparent huge pages with QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_HUGE_PAGES,
+ * they are then aligned to and rounded up to 2 MiB.
+ */
+class ReadbackPool
+{
+public:
+    struct Statistics
+    {
+        quint64 allocations = 0;    // blocks mapped
+        quint64 reuses = 0;         // blocks handed out again
+        qint64 bytes = 0;           // currently mapped, in use or free
+    };
+
+    static ReadbackPool *instance();
+
+    explicit ReadbackPool(int capacity);
+    ~ReadbackPool();
+
+    uchar *allocate(int size);
+    void release(uchar *data);
+
+    // An image of pooled memory in a 32 bit format, the memory is returned with the last copy of the image.
+    QImage image(const QSize &size, QImage::Format format);
+    // A memory video buffer of pooled memory, returned when the buffer is released.
+    QAbstractVideoBuffer *videoBuffer(int size, int bytesPerLine);
+    // A memory video buffer sharing the pixels of an image from image(), without a copy.
+    QAbstractVideoBuffer *videoBuffer(const QImage &image);
+
+    Statistics statistics() const;
+
+private:
+    int blockSize(int size) const;
+    void *map(int size) const;
+
+    mutable QMutex m_mutex;
+    std::vector<std::pair<uchar *, int>> m_used;
+    std::vector<std::pair<uchar *, int>> m_free;   // oldest first
+    Statistics m_statistics;
+    const int m_capacity;
+    const bool m_hugePages;
+};
+
+} //namespace NemoVideoBackend
+#endif // READBACKPOOL_H
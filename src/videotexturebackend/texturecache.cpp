@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "texturecache.h"
+#include <gst/interfaces/nemoeglimagememory.h>
+
+#include <QLoggingCategory>
+
+namespace NemoVideoBackend {
+
+namespace {
+Q_LOGGING_CATEGORY(Cache, "org.sailfishos.multimedia.egltexture.cache", QtWarningMsg)
+
+void destroyImage(EGLDisplay display, EGLImageKHR image)
+{
+    static const PFNEGLDESTROYIMAGEKHRPROC eglDestroyImageKHR
+            = reinterpret_cast<PFNEGLDESTROYIMAGEKHRPROC>(eglGetProcAddress("eglDestroyImageKHR"));
+
+    eglDestroyImageKHR(display, image);
+}
+
+struct ImportedImage
+{
+    EGLDisplay display;
+    EGLImageKHR image;
+};
+
+void destroyImportedImage(gpointer data)
+{
+    ImportedImage * const imported = static_cast<ImportedImage *>(data);
+    destroyImage(imported->display, imported->image);
+    delete imported;
+}
+
+GQuark importedImageQuark()
+{
+    static const GQuark quark = g_quark_from_static_string("nemo-video-texture-backend-image");
+    return quark;
+}
+
+// Marks memories an import was attempted for, it outlives the image being taken by a cache.
+GQuark importedQuark()
+{
+    static const GQuark quark = g_quark_from_static_string("nemo-video-texture-backend-imported");
+    return quark;
+}
+}
+
+bool importImage(GstMemory *memory, EGLDisplay display)
+{
+    GstMiniObject * const object = GST_MINI_OBJECT_CAST(memory);
+    if (gst_mini_object_get_qdata(object, importedQuark())) {
+        return false;
+    }
+    gst_mini_object_set_qdata(object, importedQuark(), GINT_TO_POINTER(1), nullptr);
+
+    const EGLImageKHR image = nemo_gst_egl_image_memory_create_image(memory, display, nullptr);
+    if (!image) {
+        return false;
+    }
+
+    ImportedImage * const imported = new ImportedImage;
+    imported->display = display;
+    imported->image = image;
+    gst_mini_object_set_qdata(object, importedImageQuark(), imported, destroyImportedImage);
+
+    return true;
+}
+
+EGLImageKHR takeImportedImage(GstMemory *memory)
+{
+    ImportedImage * const imported = static_cast<ImportedImage *>(
+                gst_mini_object_steal_qdata(GST_MINI_OBJECT_CAST(memory), importedImageQuark()));
+    if (!imported) {
+        return EGL_NO_IMAGE_KHR;
+    }
+
+    const EGLImageKHR image = imported->image;
+    delete imported;
+    return image;
+}
+
+void discardImportedImage(GstMemory *memory)
+{
+    if (gpointer imported = gst_mini_object_steal_qdata(GST_MINI_OBJECT_CAST(memory), importedImageQuark())) {
+        destroyImportedImage(imported);
+    }
+}
+
+TextureCache::TextureCache(EGLDisplay display, int capacity)
+    : m_display(display)
+    , m_capacity(qMax(1, capacity))
+    , m_useCount(0)
+    , m_hits(0)
+    , m_misses(0)
+    , m_evictions(0)
+    , m_bytes(0)
+{
+    m_entries.reserve(m_capacity);
+}
+
+TextureCache::~TextureCache()
+{
+    clear();
+
+    qCDebug(Cache) << "hits" << m_hits << "misses" << m_misses << "evictions" << m_evictions;
+}
+
+int TextureCache::capacity() const
+{
+    return m_capacity;
+}
+
+int TextureCache::count() const
+{
+    return m_entries.count();
+}
+
+bool TextureCache::contains(GstMemory *memory) const
+{
+    return m_entries.contains(memory);
+}
+
+const TextureCache::Texture *TextureCache::find(GstMemory *memory)
+{
+    const auto it = m_entries.find(memory);
+    if (it == m_entries.end()) {
+        ++m_misses;
+        return nullptr;
+    }
+
+    ++m_hits;
+    it->lastUsed = ++m_useCount;
+    return &it->texture;
+}
+
+const TextureCache::Texture *TextureCache::insert(GstMemory *memory, EGLImageKHR image, qint64 bytes)
+{
+    // Only textures nothing can show again make room, a pool larger than the capacity would
+    // otherwise have live textures destroyed and imported again in a loop.
+    while (m_entries.count() >= m_capacity && evict(nullptr, true)) {
+    }
+    if (m_entries.count() >= m_capacity) {
+        qCDebug(Cache) << "over capacity with" << m_entries.count() + 1 << "live textures";
+    }
+
+    Entry entry;
+    entry.texture.image = image;
+    entry.lastUsed = ++m_useCount;
+    entry.bytes = bytes;
+    m_bytes += bytes;
+
+    glGenTextures(1, &entry.texture.textureId);
+    glBindTexture(GL_TEXTURE_EXTERNAL_OES, entry.texture.textureId);
+    glTexParameterf(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameterf(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    return &m_entries.insert(gst_memory_ref(memory), entry)->texture;
+}
+
+void TextureCache::clear()
+{
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+        destroy(it.key(), it.value());
+    }
+    m_entries.clear();
+    m_bytes = 0;
+}
+
+int TextureCache::trim(qint64 budget, GstMemory *keep)
+{
+    int evicted = 0;
+    while (m_bytes > budget && evict(keep)) {
+        ++evicted;
+    }
+    return evicted;
+}
+
+bool TextureCache::evict(GstMemory *keep, bool orphanedOnly)
+{
+    // A memory only the cache still holds was freed by its allocator's owner, a source
+    // allocating new memory for every frame for example, and will never be shown again.
+    auto victim = m_entries.end();
+    bool victimOrphaned = false;
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (it.key() == keep) {
+            continue;
+        }
+        const bool orphaned = GST_MINI_OBJECT_REFCOUNT_VALUE(it.key()) == 1;
+        if (orphanedOnly && !orphaned) {
+            continue;
+        }
+        if (victim == m_entries.end()
+                || (orphaned && !victimOrphaned)
+                || (orphaned == victimOrphaned && it->lastUsed < victim->lastUsed)) {
+            victim = it;
+            victimOrphaned = orphaned;
+        }
+    }
+
+    if (victim != m_entries.end()) {
+        ++m_evictions;
+        qCDebug(Cache) << "evicting texture" << victim->texture.textureId << (victimOrphaned ? "(orphaned)" : "");
+
+        m_bytes -= victim->bytes;
+        destroy(victim.key(), victim.value());
+        m_entries.erase(victim);
+        return true;
+    }
+    return false;
+}
+
+void TextureCache::destroy(GstMemory *memory, const Entry &entry)
+{
+    glDeleteTextures(1, &entry.texture.textureId);
+
+    destroyImage(m_display, entry.texture.image);
+
+    // The memory may be imported again ahead of being shown.
+    gst_mini_object_set_qdata(GST_MINI_OBJECT_CAST(memory), importedQuark(), nullptr, nullptr);
+    gst_memory_unref(memory);
+}
+
+} //namespace NemoVideoBackend
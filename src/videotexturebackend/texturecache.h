@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2020 Open Mobile Platform LLC.
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <QHash>
+#include <QOpenGLContext>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <gst/gst.h>
+
+namespace NemoVideoBackend {
+
+// Creates an EGLImage for memory off the render thread and attaches it to the memory until a
+// texture cache takes it, the image is destroyed with the memory if that never happens.
+// Only the first call for a memory does anything, returns true if that created an image.
+bool importImage(GstMemory *memory, EGLDisplay display);
+
+// Detaches the image importImage attached to memory, the caller becomes its owner.
+EGLImageKHR takeImportedImage(GstMemory *memory);
+
+// Destroys an image importImage attached to memory, if it has one.
+void discardImportedImage(GstMemory *memory);
+
+/**
+ * @brief The TextureCache class
+ * The EGLImages and GL textures imported for the memories of a sink's buffers,
+ * looked up by memory so a pool's buffers are only imported once.
+ * The cache is bounded, once it is full entries whose memory has been freed by
+ * everything but the cache are evicted to make room as they can never be shown
+ * again; while buffers still hold all of them the cache grows past its capacity.
+ * Entries can also be trimmed, least recently used first, to a budget of the
+ * memory their images take. Render thread only.
+ */
+class TextureCache
+{
+public:
+    struct Texture
+    {
+        EGLImageKHR image;
+        GLuint textureId;
+    };
+
+    TextureCache(EGLDisplay display, int capacity);
+    ~TextureCache();
+
+    int capacity() const;
+    int count() const;
+
+    bool contains(GstMemory *memory) const;
+
+    // Returns the texture imported for memory or null if there is none.
+    const Texture *find(GstMemory *memory);
+
+    // Creates a texture for an image imported from memory, taking ownership of the image.
+    // Bytes is an estimate of the memory the image takes.
+    const Texture *insert(GstMemory *memory, EGLImageKHR image, qint64 bytes = 0);
+
+    // Evicts entries other than keep's until their images take no more than budget bytes,
+    // returns how many were evicted.
+    int trim(qint64 budget, GstMemory *keep = nullptr);
+
+    // Destroys all textures and images and releases their memories.
+    void clear();
+
+    quint64 hits() const { return m_hits; }
+    quint64 misses() const { return m_misses; }
+    quint64 evictions() const { return m_evictions; }
+    qint64 bytes() const { return m_bytes; }
+
+private:
+    struct Entry
+    {
+        Texture texture;
+        quint64 lastUsed;
+        qint64 bytes;
+    };
+
+    bool evict(GstMemory *keep = nullptr, bool orphanedOnly = false);
+    void destroy(GstMemory *memory, const Entry &entry);
+
+    QHash<GstMemory *, Entry> m_entries;
+    EGLDisplay m_display;
+    int m_capacity;
+    quint64 m_useCount;
+    quint64 m_hits;
+    quint64 m_misses;
+    quint64 m_evictions;
+    qint64 m_bytes;
+};
+
+} //namespace NemoVideoBackend
+#endif // TEXTURECACHE_H
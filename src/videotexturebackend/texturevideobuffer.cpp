@@ -31,12 +31,27 @@
  */
 
 #include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
 #include <QOpenGLFunctions>
 #include <QOpenGLFramebufferObject>
 #include <QOpenGLShaderProgram>
 
+#include "readbackpool.h"
 #include "texturevideobuffer.h"
 
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_MAP_READ_BIT
+#define GL_MAP_READ_BIT 0x0001
+#endif
+#ifndef GL_BGRA_EXT
+#define GL_BGRA_EXT 0x80E1
+#endif
+
 namespace NemoVideoBackend {
 
 static const char *c_vertexShaderCode =
@@ -54,11 +69,70 @@ static const char *c_fragmentShaderCode =
         "#extension GL_OES_EGL_image_external : require \n" \
         "varying highp vec2         textureCoords; \n" \
         "uniform samplerExternalOES frameTexture; \n" \
+        "uniform bool swapRedBlue; \n" \
+        "void main() \n" \
+        "{ \n" \
+        "    lowp vec4 color = texture2D(frameTexture, textureCoords); \n" \
+        "    gl_FragColor = swapRedBlue ? color.bgra : color; \n" \
+        "}\n";
+
+// Packs the BT.601 YUV planes of the frame four bytes to an RGBA pixel, so the FBO read back
+// is laid out in memory like the planes of a QVideoFrame of the format.
+static const char *c_packFragmentShaderCode =
+        "#extension GL_OES_EGL_image_external : require \n" \
+        "uniform samplerExternalOES frameTexture; \n" \
+        "uniform highp mat4 texMatrix; \n" \
+        "uniform highp vec2 frameSize; \n" \
+        "uniform int packing; \n" \
+        "highp vec3 yuv(highp vec2 position) \n" \
+        "{ \n" \
+        "    highp vec2 coords = (texMatrix * vec4(position / frameSize, 0.0, 1.0)).xy; \n" \
+        "    lowp vec3 rgb = texture2D(frameTexture, coords).rgb; \n" \
+        "    return vec3(0.0625 + dot(rgb, vec3(0.257, 0.504, 0.098)), \n" \
+        "                0.5 + dot(rgb, vec3(-0.148, -0.291, 0.439)), \n" \
+        "                0.5 + dot(rgb, vec3(0.439, -0.368, -0.071))); \n" \
+        "} \n" \
         "void main() \n" \
         "{ \n" \
-        "    gl_FragColor = texture2D(frameTexture, textureCoords); \n" \
+        "    highp vec2 texel = floor(gl_FragCoord.xy); \n" \
+        "    highp float x = texel.x * 4.0; \n" \
+        "    if (texel.y < frameSize.y) { \n" \
+        "        highp float y = texel.y + 0.5; \n" \
+        "        gl_FragColor = vec4(yuv(vec2(x + 0.5, y)).x, yuv(vec2(x + 1.5, y)).x, \n" \
+        "                            yuv(vec2(x + 2.5, y)).x, yuv(vec2(x + 3.5, y)).x); \n" \
+        "    } else if (packing == 1) { \n" \
+        "        // NV12, interleaved U and V of two chroma pixels \n" \
+        "        highp float y = (texel.y - frameSize.y) * 2.0 + 1.0; \n" \
+        "        gl_FragColor = vec4(yuv(vec2(x + 1.0, y)).yz, yuv(vec2(x + 3.0, y)).yz); \n" \
+        "    } else { \n" \
+        "        // YUV420P, each row holds two rows of the U or V plane \n" \
+        "        highp float row = texel.y - frameSize.y; \n" \
+        "        highp float planeRows = frameSize.y / 4.0; \n" \
+        "        bool v = row >= planeRows; \n" \
+        "        if (v) row -= planeRows; \n" \
+        "        highp float chromaWidth = frameSize.x / 2.0; \n" \
+        "        highp float y = row * 2.0; \n" \
+        "        if (x >= chromaWidth) { \n" \
+        "            x -= chromaWidth; \n" \
+        "            y += 1.0; \n" \
+        "        } \n" \
+        "        x = x * 2.0 + 1.0; \n" \
+        "        y = y * 2.0 + 1.0; \n" \
+        "        highp vec3 c0 = yuv(vec2(x, y)); \n" \
+        "        highp vec3 c1 = yuv(vec2(x + 2.0, y)); \n" \
+        "        highp vec3 c2 = yuv(vec2(x + 4.0, y)); \n" \
+        "        highp vec3 c3 = yuv(vec2(x + 6.0, y)); \n" \
+        "        gl_FragColor = v ? vec4(c0.z, c1.z, c2.z, c3.z) : vec4(c0.y, c1.y, c2.y, c3.y); \n" \
+        "    } \n" \
         "}\n";
 
+static bool isPacked(QVideoFrame::PixelFormat format)
+{
+    return format == QVideoFrame::Format_Y8
+            || format == QVideoFrame::Format_NV12
+            || format == QVideoFrame::Format_YUV420P;
+}
+
 TextureVideoBuffer::TextureVideoBuffer():
     QAbstractVideoBuffer(QAbstractVideoBuffer::GLTextureHandle)
 {
@@ -94,23 +168,71 @@ uchar *TextureVideoBuffer::map(MapMode mode, int *numBytes, int *bytesPerLine)
 
 uchar *TextureVideoBuffer::realMap(MapMode mode, int *numBytes, int *bytesPerLine)
 {
-    if (m_mapMode == NotMapped && mode == ReadOnly) {
-        realUpdateFrame();
+    if (m_mapMode != NotMapped || mode != ReadOnly) {
+        return nullptr;
+    }
+
+    // Nothing is rendered for a frame until something asks for its pixels.
+    realUpdateFrame();
+    if (!m_fbo) {
+        return nullptr;
+    }
+
+    if (m_readbackBuffers > 0) {
+        if (m_pixelBuffersFilled < m_readbackBuffers) {
+            return nullptr;
+        }
+
+        // The oldest buffer in the ring, the GPU has had the most time to fill it.
+        QOpenGLExtraFunctions * const functions = QOpenGLContext::currentContext()->extraFunctions();
+        const int size = m_fboSize.width() * m_fboSize.height() * 4;
+
+        functions->glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffers[m_nextPixelBuffer]);
+        uchar * const data = static_cast<uchar *>(
+                    functions->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT));
+        functions->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        if (!data) {
+            return nullptr;
+        }
+
+        m_pixelBufferMapped = true;
         m_mapMode = mode;
-        // call toImage() only if image was not created yet by call
-        //     TextureVideoBuffer::toImage(), for example
-        if (m_image.isNull())
-            m_image = m_fbo->toImage();
 
         if (numBytes)
-            *numBytes = m_image.byteCount();
+            *numBytes = size;
 
         if (bytesPerLine)
-            *bytesPerLine = m_image.bytesPerLine();
+            *bytesPerLine = m_fboSize.width() * 4;
+
+        return data;
+    }
 
-        return m_image.bits();
+    m_mapMode = mode;
+    // read the frame back only once, however many filters map it
+    if (m_image.isNull() && isPacked(m_pixelFormat)) {
+        // The planes are already laid out top down, one packed row to a row of the image.
+        m_image = ReadbackPool::instance()->image(m_fboSize, QImage::Format_RGBA8888);
+        m_fbo->bind();
+        glReadPixels(0, 0, m_fboSize.width(), m_fboSize.height(), GL_RGBA, GL_UNSIGNED_BYTE, m_image.bits());
+        m_fbo->release();
+    } else if (m_image.isNull()) {
+        // The frame is rendered upside down and in the byte order read back, so the rows come
+        // out of glReadPixels top down and in the order of QImage::Format_ARGB32 as they are.
+        m_image = ReadbackPool::instance()->image(m_size, QImage::Format_ARGB32);
+        m_fbo->bind();
+        glReadPixels(0, 0, m_size.width(), m_size.height(),
+                     m_readBgra ? GL_BGRA_EXT : GL_RGBA, GL_UNSIGNED_BYTE, m_image.bits());
+        m_fbo->release();
     }
-    return nullptr;
+
+    if (numBytes)
+        *numBytes = m_image.byteCount();
+
+    if (bytesPerLine)
+        *bytesPerLine = m_image.bytesPerLine();
+
+    return m_image.bits();
 }
 
 void TextureVideoBuffer::unmap()
@@ -121,7 +243,13 @@ void TextureVideoBuffer::unmap()
 
 void TextureVideoBuffer::realUnmap()
 {
-    m_image = QImage();
+    if (m_pixelBufferMapped) {
+        QOpenGLExtraFunctions * const functions = QOpenGLContext::currentContext()->extraFunctions();
+        functions->glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffers[m_nextPixelBuffer]);
+        functions->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        functions->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        m_pixelBufferMapped = false;
+    }
     m_mapMode = NotMapped;
 }
 
@@ -139,7 +267,96 @@ void TextureVideoBuffer::setTextureSize(const QSize &size)
 
 void TextureVideoBuffer::realSetTextureSize(const QSize &size)
 {
-    m_size = size;
+    m_textureSize = size;
+    realUpdateSize();
+}
+
+void TextureVideoBuffer::setTextureTransform(
+        const QRectF &subRect, int orientation, bool horizontalMirror, bool verticalMirror)
+{
+    QMutexLocker locker(&m_mutex);
+    m_subRect = subRect;
+    m_orientation = orientation;
+    m_horizontalMirror = horizontalMirror;
+    m_verticalMirror = verticalMirror;
+    realUpdateSize();
+}
+
+void TextureVideoBuffer::setFrameGeometry(const QSize &size, const QRectF &crop)
+{
+    QMutexLocker locker(&m_mutex);
+    m_requestedSize = size;
+    m_crop = crop;
+    realUpdateSize();
+    m_textureUpdated = false;
+    m_image = QImage();
+}
+
+QSize TextureVideoBuffer::frameSize() const
+{
+    return m_size;
+}
+
+void TextureVideoBuffer::setPixelFormat(QVideoFrame::PixelFormat format)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (!isPacked(format)) {
+        format = QVideoFrame::Format_BGRA32;
+    }
+    if (m_pixelFormat != format) {
+        realDeleteGLResources();
+        m_pixelFormat = format;
+        realUpdateSize();
+        m_textureUpdated = false;
+        m_image = QImage();
+    }
+}
+
+void TextureVideoBuffer::realUpdateSize()
+{
+    QSizeF visible(m_textureSize.width() * m_subRect.width(), m_textureSize.height() * m_subRect.height());
+    if (m_orientation % 180 != 0) {
+        visible.transpose();
+    }
+    const QSizeF cropped(visible.width() * m_crop.width(), visible.height() * m_crop.height());
+
+    if (cropped.isEmpty()) {
+        m_size = QSize();
+    } else if (m_requestedSize.width() > 0 && m_requestedSize.height() > 0) {
+        m_size = m_requestedSize;
+    } else if (m_requestedSize.width() > 0) {
+        m_size = QSize(m_requestedSize.width(),
+                       qMax(1, qRound(cropped.height() * m_requestedSize.width() / cropped.width())));
+    } else if (m_requestedSize.height() > 0) {
+        m_size = QSize(qMax(1, qRound(cropped.width() * m_requestedSize.height() / cropped.height())),
+                       m_requestedSize.height());
+    } else {
+        m_size = cropped.toSize();
+    }
+
+    // Packed rows hold four bytes of a plane to a pixel, and the chroma planes are subsampled.
+    switch (m_pixelFormat) {
+    case QVideoFrame::Format_Y8:
+        m_size.rwidth() &= ~3;
+        m_fboSize = QSize(m_size.width() / 4, m_size.height());
+        break;
+    case QVideoFrame::Format_NV12:
+        m_size = QSize(m_size.width() & ~3, m_size.height() & ~1);
+        m_fboSize = QSize(m_size.width() / 4, m_size.height() * 3 / 2);
+        break;
+    case QVideoFrame::Format_YUV420P:
+        m_size = QSize(m_size.width() & ~7, m_size.height() & ~3);
+        m_fboSize = QSize(m_size.width() / 4, m_size.height() * 3 / 2);
+        break;
+    default:
+        m_fboSize = m_size;
+        break;
+    }
+    if (m_fboSize.isEmpty()) {
+        m_size = QSize();
+        m_fboSize = QSize();
+    }
 }
 
 void TextureVideoBuffer::setTextureId(GLuint textureId)
@@ -152,21 +369,115 @@ void TextureVideoBuffer::realSetTextureId(GLuint textureId)
 {
     m_textureId = textureId;
     m_textureUpdated = false;
+    m_image = QImage();
+}
+
+void TextureVideoBuffer::setReadbackBuffers(int count)
+{
+    QMutexLocker locker(&m_mutex);
+
+    count = count > 0 ? qBound(2, count, 3) : 0;
+    // Without OpenGL ES 3 m_readbackBuffers falls back to zero, asking again changes nothing.
+    if (m_requestedReadbackBuffers != count) {
+        realDeleteGLResources();
+        m_requestedReadbackBuffers = count;
+        m_readbackBuffers = count;
+        m_textureUpdated = false;
+        m_image = QImage();
+    }
 }
 
 /**
  * @brief TextureVideoBuffer::toImage
- * Better to call this after updateFrame() was called
+ * Renders and reads back the frame if nothing has yet
  * @return internal image, if rendered. Null image otherwise
  */
-QImage TextureVideoBuffer::toImage() const
+QImage TextureVideoBuffer::toImage()
 {
-    if (m_textureUpdated) {
-        m_image = m_fbo->toImage();
+    QMutexLocker locker(&m_mutex);
+
+    if (isPacked(m_pixelFormat)) {
+        return QImage();
+    }
+
+    if (m_image.isNull() && m_mapMode == NotMapped) {
+        int bytesPerLine = 0;
+        if (uchar *data = realMap(ReadOnly, nullptr, &bytesPerLine)) {
+            if (m_readbackBuffers > 0) {
+                // The frame is already upright and in QImage's byte order.
+                m_image = ReadbackPool::instance()->image(m_size, QImage::Format_ARGB32);
+                for (int y = 0; y < m_size.height(); ++y) {
+                    memcpy(m_image.scanLine(y), data + y * bytesPerLine, m_image.bytesPerLine());
+                }
+            }
+            realUnmap();
+        }
     }
     return m_image;
 }
 
+QVideoFrame TextureVideoBuffer::takeFrame()
+{
+    QMutexLocker locker(&m_mutex);
+
+    int numBytes = 0;
+    int bytesPerLine = 0;
+    uchar * const data = realMap(ReadOnly, &numBytes, &bytesPerLine);
+    if (!data) {
+        return QVideoFrame();
+    }
+
+    QAbstractVideoBuffer *buffer = nullptr;
+    if (m_readbackBuffers > 0) {
+        // The pixel buffer is read into again, its pixels can't be handed over.
+        buffer = ReadbackPool::instance()->videoBuffer(numBytes, bytesPerLine);
+        if (uchar * const target = buffer ? buffer->map(WriteOnly, nullptr, nullptr) : nullptr) {
+            memcpy(target, data, numBytes);
+            buffer->unmap();
+        }
+    } else {
+        buffer = ReadbackPool::instance()->videoBuffer(m_image);
+        m_image = QImage();
+    }
+    realUnmap();
+
+    return buffer ? QVideoFrame(buffer, m_size, m_pixelFormat) : QVideoFrame();
+}
+
+GLuint TextureVideoBuffer::renderTexture(bool *swapRedBlue)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (isPacked(m_pixelFormat)) {
+        return 0;
+    }
+
+    if (!m_textureUpdated) {
+        realRenderFrameToFbo();
+        m_textureUpdated = true;
+    }
+    if (!m_fbo) {
+        return 0;
+    }
+
+    if (swapRedBlue) {
+        *swapRedBlue = !m_readBgra;
+    }
+    return m_fbo->texture();
+}
+
+void TextureVideoBuffer::releaseFramebuffer()
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_mapMode != NotMapped) {
+        realUnmap();
+    }
+    m_fbo.reset(nullptr);
+    realDeletePixelBuffers();
+    m_textureUpdated = false;
+    m_image = QImage();
+}
 
 void TextureVideoBuffer::updateFrame()
 {
@@ -179,6 +490,7 @@ void TextureVideoBuffer::realUpdateFrame()
     if (!m_textureUpdated) {
         // update the video texture (called from the render thread)
         realRenderFrameToFbo();
+        realReadPixels();
         m_textureUpdated = true;
     }
 }
@@ -200,14 +512,47 @@ void TextureVideoBuffer::realCreateGLResources()
         return;
     }
 
-    // Delete FBO if the texture size changed (to recreate it later on)
-    if (m_fbo && (m_fbo->size() != m_size)) {
+    // Delete FBO if the frame size changed (to recreate it later on)
+    if (m_fbo && (m_fbo->size() != m_fboSize)) {
         m_fbo.reset(nullptr);
+        realDeletePixelBuffers();
     }
 
     // create framebuffer object if not exists
     if (!m_fbo) {
-        m_fbo.reset(new QOpenGLFramebufferObject(m_size));
+        m_fbo.reset(new QOpenGLFramebufferObject(m_fboSize));
+
+        // Read BGRA where the implementation prefers it, otherwise the shader swaps red and blue.
+        m_readBgra = false;
+        if (!isPacked(m_pixelFormat) && context->hasExtension(QByteArrayLiteral("GL_EXT_read_format_bgra"))) {
+            GLint format = GL_RGBA;
+            GLint type = GL_UNSIGNED_BYTE;
+            m_fbo->bind();
+            glGetIntegerv(GL_IMPLEMENTATION_COLOR_READ_FORMAT, &format);
+            glGetIntegerv(GL_IMPLEMENTATION_COLOR_READ_TYPE, &type);
+            m_fbo->release();
+            m_readBgra = format == GL_BGRA_EXT && type == GL_UNSIGNED_BYTE;
+        }
+
+        if (m_readbackBuffers > 0 && context->format().majorVersion() < 3) {
+            qWarning() << Q_FUNC_INFO << " Asynchronous readback needs OpenGL ES 3, reading synchronously";
+            m_readbackBuffers = 0;
+        }
+
+        if (m_readbackBuffers > 0) {
+            QOpenGLExtraFunctions * const functions = context->extraFunctions();
+
+            m_pixelBuffers.resize(m_readbackBuffers);
+            functions->glGenBuffers(m_readbackBuffers, m_pixelBuffers.data());
+            for (GLuint pixelBuffer : m_pixelBuffers) {
+                functions->glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffer);
+                functions->glBufferData(
+                            GL_PIXEL_PACK_BUFFER, m_fboSize.width() * m_fboSize.height() * 4, nullptr, GL_STREAM_READ);
+            }
+            functions->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            m_nextPixelBuffer = 0;
+            m_pixelBuffersFilled = 0;
+        }
         QObject::connect(context, &QOpenGLContext::aboutToBeDestroyed,
                          this, &TextureVideoBuffer::deleteGLResources,
                          Qt::UniqueConnection);
@@ -224,7 +569,7 @@ void TextureVideoBuffer::realCreateGLResources()
     m_program->addShader(vertexShader);
 
     QOpenGLShader *fragmentShader = new QOpenGLShader(QOpenGLShader::Fragment, m_program.get());
-    fragmentShader->compileSourceCode(c_fragmentShaderCode);
+    fragmentShader->compileSourceCode(isPacked(m_pixelFormat) ? c_packFragmentShaderCode : c_fragmentShaderCode);
     m_program->addShader(fragmentShader);
 
     m_program->bindAttributeLocation("vertexCoordsArray", 0);
@@ -248,10 +593,23 @@ void TextureVideoBuffer::realDeleteGLResources()
     }
     // delete framefuffer object
     m_fbo.reset(nullptr);
+    // delete pixel buffers
+    realDeletePixelBuffers();
     // delete shader program
     m_program.reset(nullptr);
 }
 
+void TextureVideoBuffer::realDeletePixelBuffers()
+{
+    if (!m_pixelBuffers.empty()) {
+        if (QOpenGLContext *context = QOpenGLContext::currentContext()) {
+            context->functions()->glDeleteBuffers(m_pixelBuffers.size(), m_pixelBuffers.data());
+        }
+        m_pixelBuffers.clear();
+    }
+    m_pixelBuffersFilled = 0;
+}
+
 void TextureVideoBuffer::renderFrameToFbo()
 {
     QMutexLocker locker(&m_mutex);
@@ -266,6 +624,11 @@ void TextureVideoBuffer::realRenderFrameToFbo()
 
     realCreateGLResources();
 
+    // A frame mapped off the render thread has no context to render with.
+    if (!m_fbo || !m_program) {
+        return;
+    }
+
     glBindTexture(GL_TEXTURE_EXTERNAL_OES, m_textureId);
 
     // save current render states
@@ -285,13 +648,37 @@ void TextureVideoBuffer::realRenderFrameToFbo()
 
     m_fbo->bind();
 
-    glViewport(0, 0, m_size.width(), m_size.height());
+    glViewport(0, 0, m_fboSize.width(), m_fboSize.height());
 
     m_program->bind();
     m_program->enableAttributeArray(0);
     m_program->enableAttributeArray(1);
     m_program->setUniformValue("frameTexture", GLuint(0));
-    m_program->setUniformValue("texMatrix", QMatrix4x4());
+
+    // Scaling to the frame size is done by the viewport, cropping and rotating by the texture
+    // coordinates, like the video node does for the visible part of the texture.
+    // Render the frame upside down and, unless read back as BGRA, with red and blue swapped,
+    // so the pixels read back are already laid out as a QImage::Format_ARGB32 image.
+    QMatrix4x4 texMatrix;
+    texMatrix.translate(m_subRect.x(), m_subRect.y());
+    texMatrix.scale(m_subRect.width(), m_subRect.height());
+    texMatrix.translate(0.5, 0.5);
+    texMatrix.scale(m_horizontalMirror ? -1 : 1, m_verticalMirror ? -1 : 1);
+    texMatrix.rotate(m_orientation, 0, 0, 1);
+    texMatrix.translate(-0.5, -0.5);
+    texMatrix.translate(m_crop.x(), m_crop.y());
+    texMatrix.scale(m_crop.width(), m_crop.height());
+    if (isPacked(m_pixelFormat)) {
+        // The packing shader lays the planes out top down itself.
+        m_program->setUniformValue("frameSize", QSizeF(m_size));
+        m_program->setUniformValue("packing", m_pixelFormat == QVideoFrame::Format_Y8 ? 0
+                                   : m_pixelFormat == QVideoFrame::Format_NV12 ? 1 : 2);
+    } else {
+        texMatrix.translate(0, 1);
+        texMatrix.scale(1, -1);
+        m_program->setUniformValue("swapRedBlue", !m_readBgra);
+    }
+    m_program->setUniformValue("texMatrix", texMatrix);
 
     static const GLfloat g_vertex_data[] = {
         -1.0f, 1.0f,  1.0f, 1.0f,
@@ -322,4 +709,28 @@ void TextureVideoBuffer::realRenderFrameToFbo()
     if (scissorTestEnabled) glEnable(GL_SCISSOR_TEST);
     if (blendEnabled) glEnable(GL_BLEND);
 }
+
+void TextureVideoBuffer::realReadPixels()
+{
+    if (m_readbackBuffers == 0 || !m_fbo) {
+        return;
+    }
+
+    if (m_pixelBufferMapped) {
+        realUnmap();
+    }
+
+    QOpenGLExtraFunctions * const functions = QOpenGLContext::currentContext()->extraFunctions();
+
+    // Queue the copy and return, the pixels are mapped once the ring comes back around to them.
+    m_fbo->bind();
+    functions->glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffers[m_nextPixelBuffer]);
+    functions->glReadPixels(0, 0, m_fboSize.width(), m_fboSize.height(),
+                            m_readBgra ? GL_BGRA_EXT : GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    functions->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    m_fbo->release();
+
+    m_nextPixelBuffer = (m_nextPixelBuffer + 1) % m_readbackBuffers;
+    m_pixelBuffersFilled = qMin(m_pixelBuffersFilled + 1, m_readbackBuffers);
+}
 } //namespace NemoVideoBackend
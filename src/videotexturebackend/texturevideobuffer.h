@@ -37,9 +37,11 @@
 #include <QVariant>
 #include <QImage>
 #include <QAbstractVideoBuffer>
+#include <QVideoFrame>
 #include <QMutex>
 
 #include <memory>
+#include <vector>
 
 #include <GLES2/gl2.h>    // for GLuint
 
@@ -51,9 +53,17 @@ namespace NemoVideoBackend {
 /**
  * @brief The TextureVideoBuffer class
  * Acts much like QMemoryVideoBuffer, storing pixels data in
- * QImage, which is constructed from QOpenGLFrameBufferObject,
- * where texture with textureId is rendered to. It assumes
- * EGLImage is already bound to passed texture.
+ * QImage, which is read from QOpenGLFrameBufferObject, where
+ * texture with textureId is rendered to already flipped and
+ * swizzled, so the pixels need no further pass on the CPU. It assumes
+ * EGLImage is already bound to passed texture. The texture
+ * is only rendered once a frame is mapped, its handle is the
+ * external texture itself.
+ * Frames can also be converted to planar YUV and packed into the FBO,
+ * reading back only 1 to 1.5 bytes a pixel.
+ * With asynchronous readback the pixels are copied into a ring of pixel pack
+ * buffers instead, and a map returns the oldest frame in the ring so the render
+ * thread doesn't wait for the GPU. Needs OpenGL ES 3.
  */
 class TextureVideoBuffer: public QObject, public QAbstractVideoBuffer
 {
@@ -71,8 +81,38 @@ public:
 
     void setTextureSize(const QSize &size);
     void setTextureId(GLuint textureId);
-
-    QImage toImage() const;
+    // The visible part of the texture and how it is shown, frames are of that picture.
+    void setTextureTransform(const QRectF &subRect, int orientation, bool horizontalMirror, bool verticalMirror);
+
+    // The frame is scaled to size and cropped to the normalized crop rectangle of the visible
+    // picture on the GPU. An empty dimension follows the aspect ratio of the crop.
+    void setFrameGeometry(const QSize &size, const QRectF &crop);
+    QSize requestedSize() const { return m_requestedSize; }
+    QRectF crop() const { return m_crop; }
+    // The size of mapped frames.
+    QSize frameSize() const;
+
+    // Y8, NV12 and YUV420P frames are converted and packed on the GPU, anything else
+    // is read back as BGRA32. The frame size is rounded down to fit the chroma subsampling.
+    void setPixelFormat(QVideoFrame::PixelFormat format);
+    QVideoFrame::PixelFormat pixelFormat() const { return m_pixelFormat; }
+
+    // Reads frames back through count pixel buffers, mapped frames lag count - 1 mapped frames
+    // behind and fail to map until the ring is full. Zero reads synchronously.
+    void setReadbackBuffers(int count);
+
+    QImage toImage();
+
+    // Maps the frame and hands its pixels over in a frame of pooled memory, which the buffer
+    // never touches again. The next map reads into a new block. Null if nothing was read back.
+    QVideoFrame takeFrame();
+
+    // Renders the frame on the GPU only and returns the texture of the FBO, laid out like a
+    // mapped frame, with red and blue swapped if swapRedBlue is set. Valid until the frame
+    // changes or the FBO is released.
+    GLuint renderTexture(bool *swapRedBlue);
+    // Deletes the FBO and its texture, the shader is kept for the next frame.
+    void releaseFramebuffer();
 
 public Q_SLOTS:
     void updateFrame();
@@ -94,6 +134,9 @@ protected:
     void realCreateGLResources();
     void realDeleteGLResources();
     void realRenderFrameToFbo();
+    void realReadPixels();
+    void realUpdateSize();
+    void realDeletePixelBuffers();
 
 private:
     bool     m_textureUpdated = false;
@@ -103,8 +146,25 @@ private:
     std::unique_ptr<QOpenGLFramebufferObject> m_fbo;
     std::unique_ptr<QOpenGLShaderProgram> m_program;
 
+    std::vector<GLuint> m_pixelBuffers;
+    int      m_readbackBuffers = 0;
+    int      m_requestedReadbackBuffers = 0;
+    int      m_nextPixelBuffer = 0;
+    int      m_pixelBuffersFilled = 0;
+    bool     m_pixelBufferMapped = false;
+    bool     m_readBgra = false;
+
     mutable QImage m_image;
-    QSize    m_size;
+    QSize    m_textureSize;
+    QRectF   m_subRect = QRectF(0, 0, 1, 1);
+    int      m_orientation = 0;
+    bool     m_horizontalMirror = false;
+    bool     m_verticalMirror = false;
+    QSize    m_requestedSize;
+    QRectF   m_crop = QRectF(0, 0, 1, 1);
+    QSize    m_size;     // of mapped frames
+    QSize    m_fboSize;  // four bytes of packed planes to a pixel
+    QVideoFrame::PixelFormat m_pixelFormat = QVideoFrame::Format_BGRA32;
     QMutex   m_mutex;
 };
 
@@ -31,34 +31,118 @@
  */
 
 #include "videotexturebackend.h"
+#include "memorypressure.h"
+#include "readbackpool.h"
 #include <gst/interfaces/nemoeglimagememory.h>
 
 #include <QLoggingCategory>
 #include <QElapsedTimer>
+#include <QtMath>
+
+#include <algorithm>
+#include <climits>
+
+#ifndef GL_UNPACK_ROW_LENGTH
+#define GL_UNPACK_ROW_LENGTH 0x0CF2
+#endif
 
 
 namespace NemoVideoBackend {
 
 namespace {
 Q_LOGGING_CATEGORY(Timing, "org.sailfishos.multimedia.egltexture.times", QtWarningMsg)
+Q_LOGGING_CATEGORY(Qos, "org.sailfishos.multimedia.egltexture.qos", QtWarningMsg)
+Q_LOGGING_CATEGORY(Retention, "org.sailfishos.multimedia.egltexture.retention", QtWarningMsg)
+
+// How often the render statistics are reported upstream.
+const GstClockTime c_qosInterval = 250 * GST_MSECOND;
+
+int textureCacheCapacity()
+{
+    // Enough for the buffer pools of the droid decoders and camera.
+    static const int capacity = qEnvironmentVariableIntValue("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_TEXTURE_CACHE");
+    return capacity > 0 ? capacity : 32;
+}
+
+bool hasExtension(EGLDisplay display, const char *extension)
+{
+    const char * const extensions = eglQueryString(display, EGL_EXTENSIONS);
+    return extensions && QByteArray(extensions).split(' ').contains(extension);
+}
+
+// How long frames have to be shown without importing a new buffer before playback counts as smooth.
+const GstClockTime c_smoothPeriod = GST_SECOND;
+
+// How often the texture memory is reported while it changes.
+const GstClockTime c_retentionReportInterval = GST_SECOND;
+
+QEvent::Type statisticsEventType()
+{
+    static const QEvent::Type type = QEvent::Type(QEvent::registerEventType());
+    return type;
+}
 }
 
 GStreamerVideoTexture::GStreamerVideoTexture(EGLDisplay display)
     : m_buffer(nullptr)
+    , m_trace(nullptr)
+    , m_sequence(0)
     , m_display(display)
+    , m_textures(display, textureCacheCapacity())
+    , m_retentionBudget(-1)
+    , m_texturesTrimmed(0)
+    , m_currentMemory(nullptr)
+    , m_firstFrameTime(GST_CLOCK_TIME_NONE)
+    , m_lastImportTime(GST_CLOCK_TIME_NONE)
+    , m_firstSmoothFrameTime(-1)
     , m_subRect(0, 0, 1, 1)
+    , m_orientation(0)
+    , m_horizontalMirror(false)
+    , m_verticalMirror(false)
     , m_textureId(0)
     , m_buffersInvalidated(false)
+    , m_freezePending(false)
+    , m_smoothReported(false)
+    , m_filterFrame(0)
+    , m_lastFrameTime(GST_CLOCK_TIME_NONE)
+    , m_frameRate(30)
+    , m_filteredTextureId(0)
+    , m_filteredSwapRedBlue(false)
+    , m_uploadTextures{ 0, 0 }
+    , m_nextUpload(0)
 {
+    // Filters run on a worker pool with this many frames queued for them, instead of on
+    // the render thread.
+    static const int asyncFilters = qEnvironmentVariableIntValue("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_ASYNC_FILTERS");
+    static const bool dropNewest = qgetenv("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_ASYNC_FILTERS_DROP") == "newest";
+    // Filters only read frames, so they can run on the same frame at once on different cores.
+    static const bool parallelFilters = qEnvironmentVariableIntValue("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_PARALLEL_FILTERS") != 0;
+
+    if (asyncFilters > 0) {
+        m_asyncFilters.reset(new AsyncFilterChain(
+                asyncFilters, dropNewest ? AsyncFilterChain::DropNewest : AsyncFilterChain::DropOldest, parallelFilters));
+    } else if (parallelFilters) {
+        m_filterPool.reset(new QThreadPool);
+    }
 }
 
 GStreamerVideoTexture::~GStreamerVideoTexture()
 {
+    // Wait for the runnables before deleting them.
+    m_asyncFilters.reset();
+
     for (const FilterInfo &info : m_filters) {
         delete info.runnable;
     }
 
-    destroyCachedTextures();
+    for (GstMemory *memory : m_prewarmMemories) {
+        gst_memory_unref(memory);
+    }
+    m_textures.clear();
+
+    if (m_uploadSize.isValid()) {
+        glDeleteTextures(2, m_uploadTextures);
+    }
 
     if (m_buffer) {
         gst_buffer_unref(m_buffer);
@@ -67,7 +151,7 @@ GStreamerVideoTexture::~GStreamerVideoTexture()
 
 int GStreamerVideoTexture::textureId() const
 {
-    return m_textureId;
+    return isExternal() ? m_textureId : m_filteredTextureId;
 }
 
 QSize GStreamerVideoTexture::textureSize() const
@@ -80,6 +164,23 @@ void GStreamerVideoTexture::setTextureSize(const QSize &size)
     m_textureSize = size;
 }
 
+void GStreamerVideoTexture::setOrientation(int orientation, bool horizontalMirror, bool verticalMirror)
+{
+    m_orientation = orientation;
+    m_horizontalMirror = horizontalMirror;
+    m_verticalMirror = verticalMirror;
+}
+
+QMatrix4x4 GStreamerVideoTexture::filteredFrameMatrix() const
+{
+    QMatrix4x4 matrix;
+    matrix.translate(0.5, 0.5);
+    matrix.scale(m_horizontalMirror ? -1 : 1, m_verticalMirror ? -1 : 1);
+    matrix.rotate(m_orientation, 0, 0, 1);
+    matrix.translate(-0.5, -0.5);
+    return matrix.inverted();
+}
+
 bool GStreamerVideoTexture::hasAlphaChannel() const
 {
     return false;
@@ -92,12 +193,20 @@ bool GStreamerVideoTexture::hasMipmaps() const
 
 QRectF GStreamerVideoTexture::normalizedTextureSubRect() const
 {
+    if (!isExternal()) {
+        // filtered frames are of the visible part of the texture already
+        return QRectF(0, 0, 1, 1);
+    }
     return m_subRect;
 }
 
 void GStreamerVideoTexture::bind()
 {
-    glBindTexture(GL_TEXTURE_EXTERNAL_OES, m_textureId);
+    if (isExternal()) {
+        glBindTexture(GL_TEXTURE_EXTERNAL_OES, m_textureId);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, m_filteredTextureId);
+    }
 }
 
 bool GStreamerVideoTexture::updateTexture()
@@ -105,9 +214,22 @@ bool GStreamerVideoTexture::updateTexture()
     static const PFNGLEGLIMAGETARGETTEXTURE2DOESPROC glEGLImageTargetTexture2DOES
             = reinterpret_cast<PFNGLEGLIMAGETARGETTEXTURE2DOESPROC>(eglGetProcAddress("glEGLImageTargetTexture2DOES"));
 
+    if (m_freezePending) {
+        m_freezePending = false;
+        // A new frame replaces the one to freeze anyway.
+        if (!m_bufferChanged && !m_buffersInvalidated && freezeFrame()) {
+            return true;
+        }
+    }
+
     if (m_buffersInvalidated) {
         m_buffersInvalidated = false;
-        destroyCachedTextures();
+        m_textures.clear();
+        m_currentMemory = nullptr;
+
+        m_firstFrameTime = GST_CLOCK_TIME_NONE;
+        m_firstSmoothFrameTime = -1;
+        m_smoothReported = false;
     } else if (!m_bufferChanged) {
         return false;
     }
@@ -115,6 +237,11 @@ bool GStreamerVideoTexture::updateTexture()
     m_bufferChanged = false;
 
     m_textureId = 0;
+    m_filteredTextureId = 0;
+    m_filteredFrame = QVideoFrame();
+    if (m_frozenFrame) {
+        m_frozenFrame->releaseFramebuffer();
+    }
 
     if (!m_buffer || gst_buffer_n_memory(m_buffer) == 0) {
         return true;
@@ -155,82 +282,164 @@ bool GStreamerVideoTexture::updateTexture()
 
     GstMemory *memory = gst_buffer_peek_memory(m_buffer, 0);
 
-    for (CachedTexture &texture : m_textures) {
-        if (texture.memory == memory) {
-            m_textureId = texture.textureId;
-            glBindTexture(GL_TEXTURE_EXTERNAL_OES, m_textureId);
-            QElapsedTimer timer;
-            timer.start();
-            glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, texture.image);
-            qCDebug(Timing) << m_textureId << "bound in" << timer.elapsed();
-            break;
-        }
+    if (m_trace) {
+        m_trace->stamp(m_sequence, FrameTrace::ImportStart);
     }
 
-    if (m_textureId == 0) {
-        if (EGLImageKHR image = nemo_gst_egl_image_memory_create_image(memory, m_display, nullptr)) {
-            glGenTextures(1, &m_textureId);
-            glBindTexture(GL_TEXTURE_EXTERNAL_OES, m_textureId);
-            glTexParameterf(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameterf(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-            QElapsedTimer timer;
-            timer.start();
-            glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, image);
-            qCDebug(Timing) << m_textureId << "initial bind in" << timer.elapsed();
-            CachedTexture texture = { gst_memory_ref(memory), image, m_textureId};
-            m_textures.push_back(texture);
+    const TextureCache::Texture *texture = m_textures.find(memory);
+    const bool imported = !texture;
+    if (imported) {
+        // Normally the streaming thread created the image already, unless the memory
+        // is shown again after its texture was evicted.
+        EGLImageKHR image = takeImportedImage(memory);
+        if (!image) {
+            image = nemo_gst_egl_image_memory_create_image(memory, m_display, nullptr);
+        }
+        if (image) {
+            texture = m_textures.insert(memory, image, textureBytes());
         } else {
             return true;
         }
+        if (m_retentionBudget >= 0) {
+            m_texturesTrimmed += m_textures.trim(m_retentionBudget, memory);
+        }
+    }
+    m_currentMemory = memory;
+
+    m_textureId = texture->textureId;
+    glBindTexture(GL_TEXTURE_EXTERNAL_OES, m_textureId);
+    QElapsedTimer timer;
+    timer.start();
+    glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, texture->image);
+    qCDebug(Timing) << m_textureId << (imported ? "initial bind in" : "bound in") << timer.elapsed();
+
+    // Time to the first smooth frame is the time from the first frame until the last one which had
+    // to be imported, reported once no frame has needed importing for a while.
+    const GstClockTime now = gst_util_get_timestamp();
+    if (!GST_CLOCK_TIME_IS_VALID(m_firstFrameTime)) {
+        m_firstFrameTime = now;
+        m_lastImportTime = now;
+    } else if (imported) {
+        m_lastImportTime = now;
+    } else if (!m_smoothReported && now - m_lastImportTime >= c_smoothPeriod) {
+        m_smoothReported = true;
+        m_firstSmoothFrameTime = (m_lastImportTime - m_firstFrameTime) / GST_MSECOND;
+        qCDebug(Timing) << "first smooth frame after" << m_firstSmoothFrameTime << "ms";
     }
 
-    // if we have video filters attached to owning VideoOutput,
-    // render video frame into a framebuffer to be able to get its pixels;
-    // if no filters, don't do this, it affects performance.
+    // At most one more texture a frame, so warming up the pool never adds up to a spike.
+    prewarmNext();
+
+    if (m_trace) {
+        m_trace->stamp(m_sequence, FrameTrace::ImportEnd);
+    }
+
+    // if we have video filters attached to owning VideoOutput, hand them
+    // the texture; it is rendered into a framebuffer to get its pixels
+    // only if a filter maps the frame, it affects performance.
 
     if (!m_filters.isEmpty()) {
-        if (!m_videoBuffer) {
-            // create only once
-            m_videoBuffer.reset(new TextureVideoBuffer());
+        // Rate limited filters run every so many frames, which depends on the frame rate.
+        if (GST_CLOCK_TIME_IS_VALID(m_lastFrameTime) && now > m_lastFrameTime) {
+            const qreal frameRate = qreal(GST_SECOND) / (now - m_lastFrameTime);
+            m_frameRate += (frameRate - m_frameRate) / 16;
+            for (const FilterInfo &info : m_filters) {
+                if (filterInterval(info) != info.interval) {
+                    scheduleFilters();
+                    break;
+                }
+            }
         }
-        // update texture size and ID for every frame
-        m_videoBuffer->setTextureSize(m_textureSize);
-        m_videoBuffer->setTextureId(m_textureId);
-        m_videoBuffer->updateFrame();  // renders frame image to FBO
+        m_lastFrameTime = now;
+
+        // Skip the frame altogether unless some filter is due.
+        if (std::any_of(m_filters.cbegin(), m_filters.cend(), [this](const FilterInfo &info) { return isDue(info); })) {
+            // update texture size and ID for every frame
+            for (const std::unique_ptr<TextureVideoBuffer> &videoBuffer : m_videoBuffers) {
+                videoBuffer->setTextureSize(m_textureSize);
+                videoBuffer->setTextureTransform(m_subRect, m_orientation, m_horizontalMirror, m_verticalMirror);
+                videoBuffer->setTextureId(m_textureId);
+            }
+            if (m_trace) {
+                m_trace->stamp(m_sequence, FrameTrace::FilterStart);
+            }
+
+            callVideoFilterRunnables();
 
-        callVideoFilterRunnables();
+            if (m_trace) {
+                m_trace->stamp(m_sequence, FrameTrace::FilterEnd);
+            }
+        }
+        ++m_filterFrame;
     }
 
     return true;
 }
 
-void GStreamerVideoTexture::destroyCachedTextures()
+void GStreamerVideoTexture::setBuffer(GstBuffer *buffer, quint64 sequence)
 {
-    static const PFNEGLDESTROYIMAGEKHRPROC eglDestroyImageKHR
-            = reinterpret_cast<PFNEGLDESTROYIMAGEKHRPROC>(eglGetProcAddress("eglDestroyImageKHR"));
+    m_sequence = sequence;
 
-    for (CachedTexture &texture : m_textures) {
-        glDeleteTextures(1, &texture.textureId);
+    if (m_buffer != buffer) {
+        m_bufferChanged = true;
 
-        eglDestroyImageKHR(m_display, texture.image);
+        if (m_buffer) {
+            gst_buffer_unref(m_buffer);
+        }
+        m_buffer = gst_buffer_ref(buffer);
+    }
+}
 
-        gst_memory_unref(texture.memory);
+// Gives the buffer back while keeping its texture, which may be drawn again but whose content
+// the buffer's owner is free to overwrite.
+void GStreamerVideoTexture::releaseBuffer()
+{
+    if (m_buffer) {
+        gst_buffer_unref(m_buffer);
+        m_buffer = nullptr;
     }
-    m_textures.clear();
 }
 
+void GStreamerVideoTexture::setTrace(FrameTrace *trace)
+{
+    m_trace = trace;
+}
 
-void GStreamerVideoTexture::setBuffer(GstBuffer *buffer)
+void GStreamerVideoTexture::prewarm(const QVector<GstMemory *> &memories)
 {
-    if (m_buffer != buffer) {
-        m_bufferChanged = true;
+    m_prewarmMemories += memories;
+}
 
-        if (m_buffer) {
-            gst_buffer_unref(m_buffer);
+// Creates and binds the texture of the next memory imported ahead of being shown, skipping those
+// shown in the meantime.
+void GStreamerVideoTexture::prewarmNext()
+{
+    static const PFNGLEGLIMAGETARGETTEXTURE2DOESPROC glEGLImageTargetTexture2DOES
+            = reinterpret_cast<PFNGLEGLIMAGETARGETTEXTURE2DOESPROC>(eglGetProcAddress("glEGLImageTargetTexture2DOES"));
+
+    while (!m_prewarmMemories.isEmpty()) {
+        GstMemory * const memory = m_prewarmMemories.takeFirst();
+
+        bool bound = false;
+        if (m_textures.contains(memory)) {
+            // The render thread imported it itself before the background import was done.
+            discardImportedImage(memory);
+        } else if (m_textures.count() < m_textures.capacity()
+                   && (m_retentionBudget < 0 || m_textures.bytes() + textureBytes() <= m_retentionBudget)) {
+            if (EGLImageKHR image = takeImportedImage(memory)) {
+                QElapsedTimer timer;
+                timer.start();
+                const TextureCache::Texture * const texture = m_textures.insert(memory, image, textureBytes());
+                glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, texture->image);
+                qCDebug(Timing) << texture->textureId << "prewarmed in" << timer.elapsed();
+                bound = true;
+            }
+        }
+        gst_memory_unref(memory);
+
+        if (bound) {
+            break;
         }
-        m_buffer = gst_buffer_ref(buffer);
     }
 }
 
@@ -242,13 +451,93 @@ void GStreamerVideoTexture::invalidateBuffers()
 void GStreamerVideoTexture::resetTextures()
 {
     m_textureId = 0;
-    destroyCachedTextures();
+    m_texturesTrimmed += m_textures.count();
+    m_textures.clear();
+    m_currentMemory = nullptr;
 
     m_bufferChanged = true;
 }
 
+void GStreamerVideoTexture::setRetentionBudget(qint64 bytes)
+{
+    if (m_retentionBudget != bytes) {
+        m_retentionBudget = bytes;
+        if (m_retentionBudget >= 0) {
+            m_texturesTrimmed += m_textures.trim(m_retentionBudget, m_currentMemory);
+        }
+    }
+}
+
+int GStreamerVideoTexture::trimTextures()
+{
+    const int trimmed = m_textures.trim(0, m_currentMemory);
+    m_texturesTrimmed += trimmed;
+    return trimmed;
+}
+
+// Renders the visible picture on the GPU into a texture no larger than it is shown, as filters
+// get it, and shows that like a frame a filter returned. Then the buffer goes back to its pool
+// and every EGLImage of the pool is destroyed.
+bool GStreamerVideoTexture::freezeFrame()
+{
+    if (m_textureId == 0 || m_textureSize.isEmpty()) {
+        return false;
+    }
+
+    QSizeF visible(m_textureSize.width() * m_subRect.width(), m_textureSize.height() * m_subRect.height());
+    if (m_orientation % 180 != 0) {
+        visible.transpose();
+    }
+    // Never larger than the picture itself.
+    const QSize size = m_freezeSize.isEmpty() || m_freezeSize.width() >= visible.width()
+            ? QSize()
+            : m_freezeSize;
+
+    if (!m_frozenFrame) {
+        m_frozenFrame.reset(new TextureVideoBuffer);
+    }
+    m_frozenFrame->setFrameGeometry(size, QRectF(0, 0, 1, 1));
+    m_frozenFrame->setTextureSize(m_textureSize);
+    m_frozenFrame->setTextureTransform(m_subRect, m_orientation, m_horizontalMirror, m_verticalMirror);
+    m_frozenFrame->setTextureId(m_textureId);
+
+    bool swapRedBlue = false;
+    const GLuint texture = m_frozenFrame->renderTexture(&swapRedBlue);
+    if (texture == 0) {
+        return false;
+    }
+
+    m_filteredFrame = QVideoFrame();
+    m_filteredTextureId = texture;
+    m_filteredSwapRedBlue = swapRedBlue;
+
+    qCDebug(Retention) << "froze a frame of" << m_frozenFrame->frameSize() << "releasing" << m_textures.count() << "textures";
+
+    m_textureId = 0;
+    m_texturesTrimmed += m_textures.count();
+    m_textures.clear();
+    m_currentMemory = nullptr;
+
+    if (m_buffer) {
+        gst_buffer_unref(m_buffer);
+        m_buffer = nullptr;
+    }
+    return true;
+}
+
+// An estimate of the memory of a buffer of the current size, they are mostly 4:2:0 YUV.
+qint64 GStreamerVideoTexture::textureBytes() const
+{
+    return qint64(m_textureSize.width()) * m_textureSize.height() * 3 / 2;
+}
+
 void GStreamerVideoTexture::syncFilters(QVector<FilterInfo> &filters)
 {
+    if (m_asyncFilters) {
+        // Runnables of removed filters may still be running.
+        m_asyncFilters->flush();
+    }
+
     QVector<FilterInfo> existingFilters = m_filters;
     m_filters.clear();
 
@@ -258,14 +547,18 @@ void GStreamerVideoTexture::syncFilters(QVector<FilterInfo> &filters)
             it->destroy = false;
             it->created = true;
 
-            m_filters.append(FilterInfo(it->filter, it->filter->createFilterRunnable()));
+            FilterInfo info(it->filter, it->filter->createFilterRunnable());
+            info.setFrameProperties(*it);
+            m_filters.append(info);
             ++it;
         } else if (!it->destroy) {
             auto existing = std::find_if(existingFilters.begin(), existingFilters.end(), [it](const FilterInfo &info) {
                return it->filter == info.filter;
             });
             if (existing != existingFilters.end()) {
-                m_filters.append(*existing);
+                FilterInfo info = *existing;
+                info.setFrameProperties(*it);
+                m_filters.append(info);
                 existingFilters.erase(existing);
             }
             ++it;
@@ -277,6 +570,94 @@ void GStreamerVideoTexture::syncFilters(QVector<FilterInfo> &filters)
     for (const FilterInfo &info : existingFilters) {
         delete info.runnable;
     }
+
+    // Drop the buffers of frame geometries no filter asks for any more.
+    m_videoBuffers.erase(std::remove_if(
+            m_videoBuffers.begin(), m_videoBuffers.end(), [this](const std::unique_ptr<TextureVideoBuffer> &buffer) {
+        return std::none_of(m_filters.cbegin(), m_filters.cend(), [&buffer](const FilterInfo &info) {
+            return info.frameSize == buffer->requestedSize()
+                    && info.frameCrop == buffer->crop()
+                    && info.framePixelFormat == buffer->pixelFormat();
+        });
+    }), m_videoBuffers.end());
+
+    scheduleFilters();
+}
+
+int GStreamerVideoTexture::filterInterval(const FilterInfo &filter) const
+{
+    // A little slack keeps jitter in the measured frame rate from changing the interval.
+    return filter.maximumFrameRate > 0
+            ? qMax(filter.frameInterval, qCeil(m_frameRate / filter.maximumFrameRate - 0.1))
+            : filter.frameInterval;
+}
+
+// Works out how often each filter runs, from its frame interval and maximum frame rate, and
+// spreads the filters running less than every frame over different frames.
+void GStreamerVideoTexture::scheduleFilters()
+{
+    // Long enough to see the pattern of typical intervals.
+    static const int window = 120;
+    int load[window] = {};
+
+    for (FilterInfo &info : m_filters) {
+        info.interval = filterInterval(info);
+
+        int bestLoad = INT_MAX;
+        for (int phase = 0; phase < qMin(info.interval, window); ++phase) {
+            int phaseLoad = 0;
+            for (int frame = phase; frame < window; frame += info.interval) {
+                phaseLoad += load[frame];
+            }
+            if (phaseLoad < bestLoad) {
+                bestLoad = phaseLoad;
+                info.phase = phase;
+            }
+        }
+        for (int frame = info.phase; frame < window; frame += info.interval) {
+            ++load[frame];
+        }
+    }
+}
+
+// Filters asking for the same frame geometry share a buffer, and so its readback.
+TextureVideoBuffer *GStreamerVideoTexture::videoBuffer(const FilterInfo &filter)
+{
+    const auto sameGeometry = [&filter](const FilterInfo &info) {
+        return info.frameSize == filter.frameSize
+                && info.frameCrop == filter.frameCrop
+                && info.framePixelFormat == filter.framePixelFormat;
+    };
+
+    // Filters get frames late but the render thread doesn't wait for the GPU to read them.
+    // A throttled filter only maps every so many frames and would get a frame the ring depth
+    // times its interval old, so frames of any geometry such a filter asks for are read synchronously.
+    static const int asyncReadbackBuffers = qEnvironmentVariableIntValue("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_ASYNC_READBACK");
+    const int readbackBuffers = std::all_of(m_filters.cbegin(), m_filters.cend(), [&sameGeometry](const FilterInfo &info) {
+        return !sameGeometry(info) || info.interval == 1;
+    }) ? asyncReadbackBuffers : 0;
+
+    for (const std::unique_ptr<TextureVideoBuffer> &buffer : m_videoBuffers) {
+        if (buffer->requestedSize() == filter.frameSize
+                && buffer->crop() == filter.frameCrop
+                && buffer->pixelFormat() == filter.framePixelFormat) {
+            // Only does anything when the intervals changed.
+            buffer->setReadbackBuffers(readbackBuffers);
+            return buffer.get();
+        }
+    }
+
+    TextureVideoBuffer * const buffer = new TextureVideoBuffer();
+    m_videoBuffers.emplace_back(buffer);
+
+    buffer->setReadbackBuffers(readbackBuffers);
+    buffer->setFrameGeometry(filter.frameSize, filter.frameCrop);
+    buffer->setPixelFormat(filter.framePixelFormat);
+    buffer->setTextureSize(m_textureSize);
+    buffer->setTextureTransform(m_subRect, m_orientation, m_horizontalMirror, m_verticalMirror);
+    buffer->setTextureId(m_textureId);
+
+    return buffer;
 }
 
 void GStreamerVideoTexture::callVideoFilterRunnables()
@@ -284,40 +665,242 @@ void GStreamerVideoTexture::callVideoFilterRunnables()
     if(m_filters.isEmpty())
         return;
 
-    // create video frame and its format descriptor: construct
-    //   video frame from video buffer
-    QVideoFrame vframe(m_videoBuffer.data(), m_textureSize, QVideoFrame::Format_BGRA32);
-    QVideoSurfaceFormat surfaceFormat(m_textureSize, vframe.pixelFormat(),
-                                      m_videoBuffer->handleType());
+    if (m_asyncFilters) {
+        queueVideoFilterRunnables();
+        return;
+    } else if (m_filterPool) {
+        runVideoFilterRunnablesInParallel();
+        return;
+    }
 
     bool frameWasFiltered = false;
+    QVideoFrame filteredFrame;
     // pass frame to each filter
 
-    for (int i = 0; i < m_filters.size(); ++i) {
+    int last = m_filters.size() - 1;
+    while (last > 0 && !isDue(m_filters.at(last))) {
+        --last;
+    }
+
+    for (int i = 0; i <= last; ++i) {
         const FilterInfo &finfo = m_filters.at(i);
-        if (Q_UNLIKELY(!finfo.runnable)) {
+        if (Q_UNLIKELY(!finfo.runnable) || !isDue(finfo)) {
             continue;
         }
 
         QVideoFilterRunnable::RunFlags runFlag = 0;
         // the only flag we can set for QVideoFilterRunnable is a marker
         //    that this filter is a last filter in chain
-        if (i == m_filters.size() - 1) {
+        if (i == last) {
             runFlag |= QVideoFilterRunnable::LastInChain;
         }
 
+        // create video frame and its format descriptor: construct
+        //   video frame from the video buffer of the geometry the filter asked for,
+        //   unless an earlier filter replaced the frame
+        TextureVideoBuffer * const videoBuffer = this->videoBuffer(finfo);
+        QVideoFrame vframe = frameWasFiltered
+                ? filteredFrame
+                : QVideoFrame(videoBuffer, videoBuffer->frameSize(), videoBuffer->pixelFormat());
+        QVideoSurfaceFormat surfaceFormat(vframe.size(), vframe.pixelFormat(), vframe.handleType());
+
         // actually call filter runnable here
         QVideoFrame newFrame = finfo.runnable->run(&vframe, surfaceFormat, runFlag);
         if (newFrame != vframe) {
             frameWasFiltered = true;
-            vframe = newFrame;
+            filteredFrame = newFrame;
+        }
+    }
+
+    // Show the frame the filters returned instead of the video frame.
+    if (frameWasFiltered && !showFilteredFrame(filteredFrame)) {
+        static bool warned = false;
+        if (!warned) {
+            warned = true;
+            qWarning() << "Can't show a frame returned by a video filter of format" << filteredFrame.pixelFormat();
+        }
+    }
+}
+
+// Texture frames are sampled as they are, memory frames are uploaded to one of two textures
+// allocated once for the frame size, so the GPU can still be reading the previous one.
+bool GStreamerVideoTexture::showFilteredFrame(QVideoFrame &frame)
+{
+    if (frame.handleType() == QAbstractVideoBuffer::GLTextureHandle) {
+        const GLuint textureId = frame.handle().toUInt();
+        if (textureId == 0 || textureId == m_textureId) {
+            return textureId != 0;
+        }
+        m_filteredFrame = frame;
+        m_filteredTextureId = textureId;
+        m_filteredSwapRedBlue = false;
+        return true;
+    }
+
+    bool swapRedBlue = false;
+    switch (frame.pixelFormat()) {
+    case QVideoFrame::Format_ARGB32:
+    case QVideoFrame::Format_ARGB32_Premultiplied:
+    case QVideoFrame::Format_RGB32:
+    case QVideoFrame::Format_BGRA32:     // the byte order of the frames filters are given
+        swapRedBlue = true;
+        break;
+    case QVideoFrame::Format_ABGR32:
+        break;
+    default:
+        // Format_BGR32 puts the padding byte first, which would take more than a red blue swap.
+        return false;
+    }
+
+    if (!frame.map(QAbstractVideoBuffer::ReadOnly)) {
+        return false;
+    }
+
+    const QSize size = frame.size();
+    if (m_uploadSize != size) {
+        if (m_uploadSize.isValid()) {
+            glDeleteTextures(2, m_uploadTextures);
+        }
+        glGenTextures(2, m_uploadTextures);
+        for (GLuint texture : m_uploadTextures) {
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.width(), size.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+        m_uploadSize = size;
+        m_nextUpload = 0;
+    }
+
+    const GLuint texture = m_uploadTextures[m_nextUpload];
+    m_nextUpload = (m_nextUpload + 1) % 2;
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    const int rowLength = frame.bytesPerLine() / 4;
+    if (rowLength == size.width()) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.width(), size.height(), GL_RGBA, GL_UNSIGNED_BYTE, frame.bits());
+    } else if (QOpenGLContext::currentContext()->format().majorVersion() >= 3) {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.width(), size.height(), GL_RGBA, GL_UNSIGNED_BYTE, frame.bits());
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    } else {
+        for (int y = 0; y < size.height(); ++y) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, size.width(), 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                            frame.bits() + y * frame.bytesPerLine());
+        }
+    }
+
+    frame.unmap();
+
+    m_filteredTextureId = texture;
+    m_filteredSwapRedBlue = swapRedBlue;
+    return true;
+}
+
+// Reads the frames back for the filters and leaves running them to the worker pool. The read
+// back memory is handed over with the frames, the video buffers read the next frame into new
+// blocks of the pool.
+void GStreamerVideoTexture::queueVideoFilterRunnables()
+{
+    QVector<const FilterInfo *> due;
+    QVector<AsyncFilterChain::Stage> stages;
+
+    for (const FilterInfo &finfo : m_filters) {
+        if (Q_UNLIKELY(!finfo.runnable) || !isDue(finfo)) {
+            continue;
+        }
+        due.append(&finfo);
+
+        const AsyncFilterChain::Stage stage = { finfo.filter, finfo.runnable, QVideoFrame(), QVideoSurfaceFormat(), 0 };
+        stages.append(stage);
+    }
+
+    if (stages.isEmpty()) {
+        return;
+    }
+
+    // A frame the queue would drop on arrival isn't worth rendering and reading back.
+    if (m_asyncFilters->rejectsNext()) {
+        m_asyncFilters->skip(stages);
+        return;
+    }
+
+    stages.clear();
+    QHash<TextureVideoBuffer *, QVideoFrame> frames;
+
+    for (const FilterInfo *finfo : due) {
+        TextureVideoBuffer * const videoBuffer = this->videoBuffer(*finfo);
+        auto frame = frames.find(videoBuffer);
+        if (frame == frames.end()) {
+            // Null if nothing was read back yet.
+            frame = frames.insert(videoBuffer, videoBuffer->takeFrame());
+        }
+
+        if (frame->isValid()) {
+            const AsyncFilterChain::Stage stage = {
+                finfo->filter,
+                finfo->runnable,
+                *frame,
+                QVideoSurfaceFormat(frame->size(), frame->pixelFormat()),
+                0
+            };
+            stages.append(stage);
+        }
+    }
+
+    if (!stages.isEmpty()) {
+        m_asyncFilters->push(stages);
+    }
+}
+
+// Reads each frame back once and lets the filters map it at the same time from the pool,
+// the frames stay mapped until all filters have returned. Filters whose frame isn't read
+// back yet are skipped.
+void GStreamerVideoTexture::runVideoFilterRunnablesInParallel()
+{
+    QVector<AsyncFilterChain::Stage> stages;
+    QHash<TextureVideoBuffer *, QVideoFrame> sources;
+
+    for (const FilterInfo &finfo : m_filters) {
+        if (Q_UNLIKELY(!finfo.runnable) || !isDue(finfo)) {
+            continue;
+        }
+
+        TextureVideoBuffer * const videoBuffer = this->videoBuffer(finfo);
+        auto source = sources.find(videoBuffer);
+        if (source == sources.end()) {
+            QVideoFrame frame(videoBuffer, videoBuffer->frameSize(), videoBuffer->pixelFormat());
+            frame.map(QAbstractVideoBuffer::ReadOnly);
+            source = sources.insert(videoBuffer, frame);
+        }
+
+        if (source->isMapped()) {
+            const QVideoFrame frame(
+                        new MappedVideoBuffer(source->bits(), source->mappedBytes(), source->bytesPerLine()),
+                        source->size(),
+                        source->pixelFormat());
+            const AsyncFilterChain::Stage stage = {
+                finfo.filter,
+                finfo.runnable,
+                frame,
+                QVideoSurfaceFormat(frame.size(), frame.pixelFormat()),
+                0
+            };
+            stages.append(stage);
         }
     }
 
-    // TODO: if frame data has changed, write it back to video buffer.
-    if (frameWasFiltered) {
-        qWarning() << "call_video_filters(): filters have changed a frame!";
-        qWarning() << "  But we don't support changing video frames in filter now.";
+    AsyncFilterChain::run(stages, m_filterPool.get());
+
+    // Release the shared views before unmapping what they point to.
+    stages.clear();
+    for (QVideoFrame &source : sources) {
+        if (source.isMapped()) {
+            source.unmap();
+        }
     }
 }
 
@@ -325,7 +908,10 @@ void GStreamerVideoTexture::callVideoFilterRunnables()
 class GStreamerVideoMaterialShader : public QSGMaterialShader
 {
 public:
+    explicit GStreamerVideoMaterialShader(bool external) : m_external(external) {}
+
     static QSGMaterialType type;
+    static QSGMaterialType textureType;
 
     void updateState(const RenderState &state, QSGMaterial *newEffect, QSGMaterial *oldEffect);
     char const *const *attributeNames() const;
@@ -341,6 +927,9 @@ private:
     int id_subrect;
     int id_opacity;
     int id_texture;
+    int id_swapRedBlue;
+    int id_frameMatrix;
+    const bool m_external;
 };
 
 void GStreamerVideoMaterialShader::updateState(
@@ -360,6 +949,11 @@ void GStreamerVideoMaterialShader::updateState(
         program()->setUniformValue(id_texture, 0);
     }
 
+    if (!m_external) {
+        program()->setUniformValue(id_swapRedBlue, material->m_texture->swapRedBlue());
+        program()->setUniformValue(id_frameMatrix, material->m_texture->filteredFrameMatrix());
+    }
+
     const QRectF subRect = material->m_texture->normalizedTextureSubRect();
     program()->setUniformValue(
                 id_subrect, QVector4D(subRect.x(), subRect.y(), subRect.width(), subRect.height()));
@@ -380,9 +974,12 @@ void GStreamerVideoMaterialShader::initialize()
     id_subrect = program()->uniformLocation("subrect");
     id_opacity = program()->uniformLocation("opacity");
     id_texture = program()->uniformLocation("texture");
+    id_swapRedBlue = m_external ? -1 : program()->uniformLocation("swapRedBlue");
+    id_frameMatrix = m_external ? -1 : program()->uniformLocation("frameMatrix");
 }
 
 QSGMaterialType GStreamerVideoMaterialShader::type;
+QSGMaterialType GStreamerVideoMaterialShader::textureType;
 
 const char *GStreamerVideoMaterialShader::vertexShader() const
 {
@@ -400,6 +997,20 @@ const char *GStreamerVideoMaterialShader::vertexShader() const
 
 const char *GStreamerVideoMaterialShader::fragmentShader() const
 {
+    if (!m_external) {
+        // a frame returned by the filters
+        return  "\n uniform sampler2D texture;"
+                "\n uniform lowp float opacity;"
+                "\n uniform bool swapRedBlue;"
+                "\n uniform highp mat4 frameMatrix;"
+                "\n varying highp vec2 frag_tx;"
+                "\n void main(void)"
+                "\n {"
+                "\n     lowp vec4 color = texture2D(texture, (frameMatrix * vec4(frag_tx, 0.0, 1.0)).xy);"
+                "\n     gl_FragColor = opacity * (swapRedBlue ? color.bgra : color);"
+                "\n }";
+    }
+
     return  "\n #extension GL_OES_EGL_image_external : require"
             "\n uniform samplerExternalOES texture;"
             "\n uniform lowp float opacity;"
@@ -417,12 +1028,14 @@ GStreamerVideoMaterial::GStreamerVideoMaterial(GStreamerVideoTexture *texture)
 
 QSGMaterialShader *GStreamerVideoMaterial::createShader() const
 {
-    return new GStreamerVideoMaterialShader;
+    return new GStreamerVideoMaterialShader(m_texture->isExternal());
 }
 
 QSGMaterialType *GStreamerVideoMaterial::type() const
 {
-    return &GStreamerVideoMaterialShader::type;
+    return m_texture->isExternal()
+            ? &GStreamerVideoMaterialShader::type
+            : &GStreamerVideoMaterialShader::textureType;
 }
 
 int GStreamerVideoMaterial::compare(const QSGMaterial *other) const
@@ -480,22 +1093,110 @@ void GStreamerVideoNode::setBoundingRect(
 NemoVideoTextureBackend::NemoVideoTextureBackend(QDeclarativeVideoOutput *parent)
     : QDeclarativeVideoBackend(parent)
     , m_sink(nullptr)
-    , m_queuedBuffer(nullptr)
+    , m_sinkPad(nullptr)
+    , m_queueAhead(0)
+    , m_buffersInvalidated(false)
+    , m_freezeFrames(false)
+    , m_poolInvalidated(false)
+    , m_poolReleased(false)
+    , m_prewarmedPool(nullptr)
     , m_currentBuffer(nullptr)
+    , m_releaseFence(EGL_NO_SYNC_KHR)
+    , m_lastSwapTime(GST_CLOCK_TIME_NONE)
+    , m_swapInterval(GST_CLOCK_TIME_NONE)
+    , m_currentSequence(0)
+    , m_swapSequence(0)
+    , m_framesConsumed(0)
+    , m_framesDropped(0)
+    , m_renderLateness(0)
+    , m_qosTime(GST_CLOCK_TIME_NONE)
+    , m_lastRunningTime(GST_CLOCK_TIME_NONE)
+    , m_frameDuration(GST_CLOCK_TIME_NONE)
+    , m_qosProportion(1.0)
+    , m_textureBudget(-1)
+    , m_textureMemory(0)
+    , m_texturesRetained(0)
+    , m_texturesTrimmed(0)
+    , m_firstSmoothFrameTime(-1)
+    , m_retentionReportTime(GST_CLOCK_TIME_NONE)
     , m_display(0)
     , m_camera(nullptr)
     , m_probeId(0)
+    , m_queryProbeId(0)
     , m_showFrameId(0)
     , m_buffersInvalidatedId(0)
     , m_orientation(0)
     , m_textureOrientation(0)
     , m_mirror(false)
+    , m_earlyRelease(false)
+    , m_currentReleased(false)
     , m_geometryChanged(false)
     , m_filtersChanged(false)
-    , m_buffersInvalidated(false)
 {
     connect(this, &NemoVideoTextureBackend::requestUpdate, q, &QQuickItem::update, Qt::QueuedConnection);
 
+    gst_segment_init(&m_segment, GST_FORMAT_TIME);
+
+    // The textures of a decoder's buffers are kept for as long as the decoder keeps the buffers,
+    // unless their memory is limited. The budget in KiB is overridden by the textureBudget property
+    // of the output, zero keeps only the texture shown.
+    static const bool noRetainTextures = qEnvironmentVariableIntValue("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_NO_RETAIN_TEXTURES") != 0;
+    static const QByteArray budget = qgetenv("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_TEXTURE_BUDGET");
+    m_textureBudget = noRetainTextures ? 0 : textureBudget(budget.isEmpty() ? QVariant() : QVariant(budget));
+    if (q->property("textureBudget").isValid()) {
+        m_textureBudget = textureBudget(q->property("textureBudget"));
+    }
+    q->installEventFilter(this);
+
+    connect(MemoryPressure::instance(), &MemoryPressure::low, this, &NemoVideoTextureBackend::lowMemory);
+
+    // Once the stream ends, or pauses or stays flushed for this many milliseconds, a copy of the last
+    // frame is shown and the decoder gets all its buffers back.
+    static const int freezeDelay = qEnvironmentVariableIntValue("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_FREEZE_FRAME");
+    m_freezeFrames = freezeDelay > 0;
+    if (m_freezeFrames) {
+        m_freezeTimer.setSingleShot(true);
+        m_freezeTimer.setInterval(freezeDelay);
+        connect(&m_freezeTimer, &QTimer::timeout, this, &NemoVideoTextureBackend::freezeFrame);
+        // Every frame restarts the timer.
+        connect(this, &NemoVideoTextureBackend::requestUpdate,
+                &m_freezeTimer, static_cast<void (QTimer::*)()>(&QTimer::start), Qt::QueuedConnection);
+    }
+
+    // Images are created one at a time, in the order buffers arrive.
+    m_importPool.setMaxThreadCount(1);
+
+    // The output may already be in a scene, later changes come through itemChange().
+    setWindow(q->window());
+
+    // Present frames by their time stamps from a queue of this many frames, which the sink fills
+    // ahead of time. The decoder's pool must have that many buffers to spare.
+    static const int frameQueueSize = qEnvironmentVariableIntValue("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_FRAME_QUEUE");
+    if (frameQueueSize > 0) {
+        m_frameQueue.reset(new FrameQueue(frameQueueSize));
+    }
+
+    // Time stamps of the most recent frames, written to the given file when the output goes away
+    // and, if an interval in milliseconds is set, periodically while it plays.
+    static const QString traceFile = QString::fromLocal8Bit(qgetenv("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_TRACE"));
+    if (!traceFile.isEmpty()) {
+        static QAtomicInt traceCount;
+        static const int traceSize = qEnvironmentVariableIntValue("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_TRACE_SIZE");
+
+        m_trace.reset(new FrameTrace(traceSize > 0 ? traceSize : 1024));
+        // A %1 in the file name is replaced with a number unique to each VideoOutput.
+        m_traceFile = traceFile.contains(QLatin1String("%1"))
+                ? traceFile.arg(traceCount.fetchAndAddRelaxed(1))
+                : traceFile;
+
+        static const int traceInterval = qEnvironmentVariableIntValue("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_TRACE_INTERVAL");
+        if (traceInterval > 0) {
+            m_traceTimer.setInterval(traceInterval);
+            connect(&m_traceTimer, &QTimer::timeout, this, &NemoVideoTextureBackend::writeTrace);
+            m_traceTimer.start();
+        }
+    }
+
     if (QPlatformNativeInterface *nativeInterface = QGuiApplication::platformNativeInterface()) {
         m_display = nativeInterface->nativeResourceForIntegration("egldisplay");
     }
@@ -503,22 +1204,42 @@ NemoVideoTextureBackend::NemoVideoTextureBackend(QDeclarativeVideoOutput *parent
         m_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
     }
 
-    if ((m_sink = gst_element_factory_make("droideglsink", NULL))) {
+    // Return each buffer to its pool once the GPU is done drawing it, rather than when the next frame
+    // replaces it, so decoders can run with smaller pools. If nothing replaces the frame and the scene
+    // is drawn again the texture is still used, by then its buffer may hold a newer picture.
+    static const bool earlyRelease = qEnvironmentVariableIntValue("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_EARLY_RELEASE") != 0;
+    m_earlyRelease = earlyRelease && hasExtension(m_display, "EGL_KHR_fence_sync");
+
+    // Another sink with the same interface can be substituted, e.g. the nemotesteglsink
+    // stand in when running without droid hardware.
+    static const QByteArray sinkName = qgetenv("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_SINK");
+
+    if ((m_sink = gst_element_factory_make(sinkName.isEmpty() ? "droideglsink" : sinkName.constData(), NULL))) {
         // Take ownership of the element or it will be destroyed when any bin it was added to is.
         gst_object_ref_sink(GST_OBJECT(m_sink));
 
-        g_object_set(G_OBJECT(m_sink), "egl-display", m_display, NULL);
+        // Lateness is reported from the render thread, see updateQos(), where it includes the wait for
+        // the swap. The sink's own reports would only measure the streaming thread and compete.
+        g_object_set(G_OBJECT(m_sink), "egl-display", m_display, "qos", FALSE, NULL);
 
         m_showFrameId = g_signal_connect(G_OBJECT(m_sink), "show-frame", G_CALLBACK(show_frame), this);
         m_buffersInvalidatedId = g_signal_connect(
                     G_OBJECT(m_sink), "buffers-invalidated", G_CALLBACK(buffers_invalidated), this);
 
+        m_sinkPad = gst_element_get_static_pad(m_sink, "sink");
         m_probeId = gst_pad_add_probe(
-                    gst_element_get_static_pad(m_sink, "sink"),
-                    GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+                    m_sinkPad,
+                    GstPadProbeType(GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH),
                     probe,
                     this,
                     NULL);
+
+        // Ask upstream for frames closer to the size they're shown at.
+        static const bool preferDisplaySize = qEnvironmentVariableIntValue("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_PREFER_DISPLAY_SIZE") != 0;
+        if (preferDisplaySize) {
+            m_queryProbeId = gst_pad_add_probe(
+                        m_sinkPad, GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM, queryProbe, this, NULL);
+        }
     }
 }
 
@@ -530,14 +1251,31 @@ NemoVideoTextureBackend::~NemoVideoTextureBackend()
         g_signal_handler_disconnect(G_OBJECT(m_sink), m_showFrameId);
         g_signal_handler_disconnect(G_OBJECT(m_sink), m_buffersInvalidatedId);
 
-        gst_pad_remove_probe(gst_element_get_static_pad(m_sink, "sink"), m_probeId);
+        gst_pad_remove_probe(m_sinkPad, m_probeId);
+        if (m_queryProbeId) {
+            gst_pad_remove_probe(m_sinkPad, m_queryProbeId);
+        }
+        gst_object_unref(GST_OBJECT(m_sinkPad));
+        m_sinkPad = nullptr;
         gst_object_unref(GST_OBJECT(m_sink));
         m_sink = 0;
     }
 
-    if (m_queuedBuffer) {
-        gst_buffer_unref(m_queuedBuffer);
+    m_mailbox.clear();
+    if (m_frameQueue) {
+        m_frameQueue->clear();
+    }
+
+    m_importPool.waitForDone();
+    for (GstMemory *memory : m_prewarmedMemories) {
+        gst_memory_unref(memory);
     }
+    forgetPool();
+
+    writeTrace();
+
+    destroyReleaseFence();
+
     if (m_currentBuffer) {
         gst_buffer_unref(m_currentBuffer);
     }
@@ -605,29 +1343,135 @@ void NemoVideoTextureBackend::cameraStateChanged(QCamera::State newState)
     }
 }
 
-bool NemoVideoTextureBackend::init(QMediaService *service)
+void NemoVideoTextureBackend::destroyReleaseFence()
 {
-    if (!m_sink) {
-        return false;
-    }
+    static const PFNEGLDESTROYSYNCKHRPROC eglDestroySyncKHR
+            = reinterpret_cast<PFNEGLDESTROYSYNCKHRPROC>(eglGetProcAddress("eglDestroySyncKHR"));
 
-    QMediaControl *control = service->requestControl(QGStreamerVideoSinkControl_iid);
-    if (control) {
-        m_control = qobject_cast<QGStreamerElementControl *>(control);
-        if (!m_control) {
-            service->releaseControl(control);
-            return false;
-        }
-    } else {
-        return false;
+    if (m_releaseFence != EGL_NO_SYNC_KHR) {
+        eglDestroySyncKHR(m_display, m_releaseFence);
+        m_releaseFence = EGL_NO_SYNC_KHR;
     }
+}
 
-    m_service = service;
-    m_control->setElement(m_sink);
+void NemoVideoTextureBackend::afterRendering()
+{
+    static const PFNEGLCREATESYNCKHRPROC eglCreateSyncKHR
+            = reinterpret_cast<PFNEGLCREATESYNCKHRPROC>(eglGetProcAddress("eglCreateSyncKHR"));
 
-    m_orientation = q->orientation();
+    // The fence follows the draw calls sampling the current frame.
+    if (m_earlyRelease && m_currentBuffer && m_releaseFence == EGL_NO_SYNC_KHR) {
+        m_releaseFence = eglCreateSyncKHR(m_display, EGL_SYNC_FENCE_KHR, nullptr);
+    }
 
-    connect(this, SIGNAL(nativeSizeChanged()), q, SLOT(_q_updateNativeSize()));
+    if (m_texture && m_trimTextures.fetchAndStoreAcquire(0)) {
+        const int trimmed = m_texture->trimTextures();
+        reportRetention(trimmed > 0 ? "trimmed" : "nothing to trim,");
+    } else {
+        reportRetention(nullptr);
+    }
+}
+
+// Emitted on the render thread with the context current, before the scene graph deletes its
+// nodes along with the texture, so the images and textures are released while they still can be.
+void NemoVideoTextureBackend::sceneGraphAboutToStop()
+{
+    if (m_texture) {
+        m_texture->resetTextures();
+        reportRetention("scene graph stopping,");
+    }
+}
+
+void NemoVideoTextureBackend::frameSwapped()
+{
+    static const PFNEGLCLIENTWAITSYNCKHRPROC eglClientWaitSyncKHR
+            = reinterpret_cast<PFNEGLCLIENTWAITSYNCKHRPROC>(eglGetProcAddress("eglClientWaitSyncKHR"));
+
+    const GstClockTime now = gst_util_get_timestamp();
+
+    // Don't wait for the GPU, if it isn't done yet the next swap or frame will release the buffer.
+    if (m_releaseFence != EGL_NO_SYNC_KHR
+            && eglClientWaitSyncKHR(m_display, m_releaseFence, 0, 0) == EGL_CONDITION_SATISFIED_KHR) {
+        destroyReleaseFence();
+
+        if (m_currentBuffer) {
+            gst_buffer_unref(m_currentBuffer);
+            m_currentBuffer = nullptr;
+            m_currentReleased = true;
+
+            if (m_texture) {
+                m_texture->releaseBuffer();
+            }
+        }
+    }
+
+    if (m_trace && m_swapSequence != 0) {
+        m_trace->stamp(m_swapSequence, FrameTrace::Swap, now);
+        m_swapSequence = 0;
+    }
+
+    if (GST_CLOCK_TIME_IS_VALID(m_lastSwapTime)) {
+        const GstClockTime interval = now - m_lastSwapTime;
+        // Idle gaps say nothing about the refresh rate.
+        if (interval < 100 * GST_MSECOND) {
+            m_swapInterval = GST_CLOCK_TIME_IS_VALID(m_swapInterval)
+                    ? (7 * m_swapInterval + interval) / 8
+                    : interval;
+        }
+    }
+    m_lastSwapTime = now;
+}
+
+// The running time at which the frame synchronized now is expected to reach the screen.
+GstClockTime NemoVideoTextureBackend::nextPresentationTime() const
+{
+    GstClock * const clock = m_sink ? gst_element_get_clock(m_sink) : nullptr;
+    if (!clock) {
+        return GST_CLOCK_TIME_NONE;
+    }
+
+    const GstClockTime clockTime = gst_clock_get_time(clock);
+    const GstClockTime baseTime = gst_element_get_base_time(m_sink);
+    gst_object_unref(clock);
+
+    if (clockTime < baseTime) {
+        return GST_CLOCK_TIME_NONE;
+    }
+
+    GstClockTime untilSwap = 0;
+    if (GST_CLOCK_TIME_IS_VALID(m_lastSwapTime) && GST_CLOCK_TIME_IS_VALID(m_swapInterval) && m_swapInterval > 0) {
+        const GstClockTime now = gst_util_get_timestamp();
+        const GstClockTime nextSwap
+                = m_lastSwapTime + ((now - m_lastSwapTime) / m_swapInterval + 1) * m_swapInterval;
+        untilSwap = nextSwap - now;
+    }
+
+    return clockTime - baseTime + untilSwap;
+}
+
+bool NemoVideoTextureBackend::init(QMediaService *service)
+{
+    if (!m_sink) {
+        return false;
+    }
+
+    QMediaControl *control = service->requestControl(QGStreamerVideoSinkControl_iid);
+    if (control) {
+        m_control = qobject_cast<QGStreamerElementControl *>(control);
+        if (!m_control) {
+            service->releaseControl(control);
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    m_service = service;
+    m_control->setElement(m_sink);
+
+    m_orientation = q->orientation();
+
+    connect(this, SIGNAL(nativeSizeChanged()), q, SLOT(_q_updateNativeSize()));
     connect(q, SIGNAL(orientationChanged()), this, SLOT(orientationChanged()));
     connect(q, SIGNAL(sourceChanged()), this, SLOT(sourceChanged()));
 
@@ -646,8 +1490,110 @@ void NemoVideoTextureBackend::releaseControl()
     }
 }
 
-void NemoVideoTextureBackend::itemChange(QQuickItem::ItemChange, const QQuickItem::ItemChangeData &)
+void NemoVideoTextureBackend::itemChange(QQuickItem::ItemChange change, const QQuickItem::ItemChangeData &changeData)
+{
+    if (change == QQuickItem::ItemSceneChange) {
+        setWindow(changeData.window);
+    } else if (change == QQuickItem::ItemVisibleHasChanged) {
+        updateSuspended();
+    }
+}
+
+void NemoVideoTextureBackend::setWindow(QQuickWindow *window)
+{
+    if (m_window) {
+        m_window->removeEventFilter(this);
+        disconnect(m_window.data(), &QWindow::visibilityChanged, this, &NemoVideoTextureBackend::updateSuspended);
+    }
+    m_window = window;
+    if (m_window) {
+        // Exposure has no signal of its own.
+        m_window->installEventFilter(this);
+        connect(m_window.data(), &QWindow::visibilityChanged, this, &NemoVideoTextureBackend::updateSuspended);
+    }
+    updateSuspended();
+}
+
+// Stops importing and drawing frames while the item is hidden or its window isn't exposed, and
+// picks up the latest frame again once it can be seen.
+void NemoVideoTextureBackend::updateSuspended()
+{
+    const bool suspended = !q->isVisible()
+            || !m_window
+            || !m_window->isExposed()
+            || m_window->visibility() == QWindow::Minimized;
+
+    if (m_suspended.fetchAndStoreRelease(suspended) != int(suspended)) {
+        qCDebug(Qos) << (suspended ? "suspended" : "resumed");
+        if (!suspended) {
+            q->update();
+        } else if (m_window) {
+            // Textures of other buffers won't be needed for a while. If the window still
+            // renders they are dropped with its next frame.
+            m_trimTextures.storeRelease(1);
+            m_window->update();
+        }
+    }
+}
+
+void NemoVideoTextureBackend::freezeFrame()
+{
+    m_freezeRequested.storeRelease(1);
+    q->update();
+}
+
+void NemoVideoTextureBackend::writeTrace()
+{
+    if (m_trace) {
+        m_trace->write(m_traceFile);
+    }
+}
+
+void NemoVideoTextureBackend::lowMemory()
+{
+    m_trimTextures.storeRelease(1);
+    if (m_window) {
+        m_window->update();
+    }
+}
+
+// Negative for no budget.
+qint64 NemoVideoTextureBackend::textureBudget(const QVariant &kilobytes)
 {
+    bool ok = false;
+    const qint64 budget = kilobytes.toLongLong(&ok);
+    return ok && budget >= 0 ? budget * 1024 : -1;
+}
+
+// Render thread, the figures are set as properties of the output on the GUI thread.
+void NemoVideoTextureBackend::reportRetention(const char *reason)
+{
+    if (!m_texture) {
+        return;
+    }
+
+    const GstClockTime now = gst_util_get_timestamp();
+    const qint64 memory = m_texture->textureMemory();
+    const int retained = m_texture->texturesRetained();
+    const qint64 firstSmoothFrameTime = m_texture->firstSmoothFrameTime();
+    if (!reason
+            && firstSmoothFrameTime == m_firstSmoothFrameTime.load()
+            && ((memory == m_textureMemory.load() && retained == m_texturesRetained.load())
+                || (GST_CLOCK_TIME_IS_VALID(m_retentionReportTime)
+                    && now - m_retentionReportTime < c_retentionReportInterval))) {
+        return;
+    }
+    m_retentionReportTime = now;
+
+    if (reason) {
+        qCDebug(Retention) << reason << "keeping" << retained << "textures of" << memory / 1024 << "KiB";
+    }
+
+    m_textureMemory.store(memory);
+    m_texturesRetained.store(retained);
+    m_texturesTrimmed.store(m_texture->texturesTrimmed());
+    m_firstSmoothFrameTime.store(firstSmoothFrameTime);
+    QCoreApplication::postEvent(this, new QEvent(statisticsEventType()));
 }
 
 QSize NemoVideoTextureBackend::nativeSize() const
@@ -665,12 +1611,64 @@ QSGNode *NemoVideoTextureBackend::updatePaintNode(QSGNode *oldNode, QQuickItem::
 {
     GStreamerVideoNode *node = static_cast<GStreamerVideoNode *>(oldNode);
 
-    QMutexLocker locker(&m_mutex);
+    GstBuffer *bufferToRelease = nullptr;
+
+    const GstClockTime presentationTime = nextPresentationTime();
+
+    // Only the frame shown last is frozen, not one just taken.
+    bool freeze = m_freezeRequested.fetchAndStoreAcquire(0) != 0;
+
+    QueuedFrame frame;
+    bool frameTaken = false;
+    if (m_frameQueue) {
+        const GstClockTime tolerance = GST_CLOCK_TIME_IS_VALID(m_swapInterval)
+                ? m_swapInterval / 2
+                : 8 * GST_MSECOND;
+        int dropped = 0;
+        frameTaken = m_frameQueue->take(&frame, presentationTime, tolerance, &dropped);
+        if (dropped > 0) {
+            m_framesDropped.fetchAndAddRelaxed(dropped);
+        }
+
+        // Frames which aren't due yet need another pass once they are.
+        if (!m_frameQueue->isEmpty()) {
+            emit requestUpdate();
+        }
+    } else {
+        frameTaken = m_mailbox.take(&frame);
+    }
+
+    if (frameTaken) {
+        freeze = freeze && !frame.buffer;
+        bufferToRelease = m_currentBuffer;
+        m_currentBuffer = frame.buffer;
+        m_currentSequence = frame.sequence;
+        m_swapSequence = frame.sequence;
+        m_currentReleased = false;
+
+        // A fence for the previous frame is moot now it's released anyway.
+        destroyReleaseFence();
 
-    if (!m_queuedBuffer) {
-        GstBuffer *currentBuffer = m_currentBuffer;
-        m_currentBuffer = nullptr;
+        if (m_trace) {
+            m_trace->stamp(frame.sequence, FrameTrace::Pickup);
+        }
+
+        if (frame.buffer) {
+            m_framesConsumed.ref();
+            if (GST_CLOCK_TIME_IS_VALID(frame.runningTime) && GST_CLOCK_TIME_IS_VALID(presentationTime)) {
+                // The sink already waited for the running time, a frame on time still reaches the
+                // screen up to a swap later.
+                const GstClockTimeDiff displayLatency = GST_CLOCK_TIME_IS_VALID(m_swapInterval)
+                        ? GstClockTimeDiff(m_swapInterval)
+                        : 0;
+                m_renderLateness.store(GST_CLOCK_DIFF(frame.runningTime, presentationTime) - displayLatency);
+            }
+        }
+    }
+
+    QMutexLocker locker(&m_mutex);
 
+    if (!m_currentBuffer && !m_currentReleased) {
         if (m_filtersChanged) {
             m_filtersChanged = false;
 
@@ -685,8 +1683,8 @@ QSGNode *NemoVideoTextureBackend::updatePaintNode(QSGNode *oldNode, QQuickItem::
 
         locker.unlock();
 
-        if (currentBuffer) {
-            gst_buffer_unref(currentBuffer);
+        if (bufferToRelease) {
+            gst_buffer_unref(bufferToRelease);
         }
 
         delete node;
@@ -698,29 +1696,39 @@ QSGNode *NemoVideoTextureBackend::updatePaintNode(QSGNode *oldNode, QQuickItem::
 
         m_geometryChanged = true;
         m_filtersChanged = !m_filters.isEmpty();
-
-        static const bool noRetainTextures = qEnvironmentVariableIntValue("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_NO_RETAIN_TEXTURES") != 0;
-
-        if (noRetainTextures) {
-            QObject::connect(q->window(), &QQuickWindow::afterRendering, node->texture(), &GStreamerVideoTexture::resetTextures, Qt::DirectConnection);
-        }
+        // A new texture has none of the pool's textures yet.
+        m_poolReleased.storeRelease(1);
+
+        connect(q->window(), &QQuickWindow::frameSwapped,
+                this, &NemoVideoTextureBackend::frameSwapped,
+                Qt::ConnectionType(Qt::DirectConnection | Qt::UniqueConnection));
+        connect(q->window(), &QQuickWindow::afterRendering,
+                this, &NemoVideoTextureBackend::afterRendering,
+                Qt::ConnectionType(Qt::DirectConnection | Qt::UniqueConnection));
+        connect(q->window(), &QQuickWindow::sceneGraphAboutToStop,
+                this, &NemoVideoTextureBackend::sceneGraphAboutToStop,
+                Qt::ConnectionType(Qt::DirectConnection | Qt::UniqueConnection));
+
+        node->texture()->setTrace(m_trace.data());
     }
 
     GStreamerVideoTexture * const texture = node->texture();
+    m_texture = texture;
 
     texture->setTextureSize(m_textureSize);
+    texture->setRetentionBudget(m_textureBudget);
     node->markDirty(QSGNode::DirtyMaterial);
 
-    if (m_buffersInvalidated) {
-        m_buffersInvalidated = false;
+    if (m_buffersInvalidated.fetchAndStoreAcquire(false)) {
         texture->invalidateBuffers();
     }
 
-    GstBuffer *bufferToRelease = nullptr;
-    if (m_currentBuffer != m_queuedBuffer) {
-        bufferToRelease = m_currentBuffer;
-
-        m_currentBuffer = gst_buffer_ref(m_queuedBuffer);
+    {
+        QMutexLocker prewarmLocker(&m_prewarmMutex);
+        if (!m_prewarmedMemories.isEmpty()) {
+            texture->prewarm(m_prewarmedMemories);
+            m_prewarmedMemories.clear();
+        }
     }
 
     if (m_filtersChanged) {
@@ -728,6 +1736,7 @@ QSGNode *NemoVideoTextureBackend::updatePaintNode(QSGNode *oldNode, QQuickItem::
         texture->syncFilters(m_filters);
     }
 
+    bool reconfigure = false;
     if (m_geometryChanged) {
         const QRectF br = q->boundingRect();
 
@@ -738,18 +1747,43 @@ QSGNode *NemoVideoTextureBackend::updatePaintNode(QSGNode *oldNode, QQuickItem::
         if (orientation < 0)
             orientation += 360;
 
-        node->setBoundingRect(
-                    rect,
-                    orientation,
-                    m_mirror && (m_textureOrientation % 180) == 0,
-                    m_mirror && (m_textureOrientation % 180) != 0);
+        const bool horizontalMirror = m_mirror && (m_textureOrientation % 180) == 0;
+        const bool verticalMirror = m_mirror && (m_textureOrientation % 180) != 0;
+
+        node->setBoundingRect(rect, orientation, horizontalMirror, verticalMirror);
+        m_displaySize = (rect.size() * (q->window() ? q->window()->devicePixelRatio() : 1.0)).toSize();
+        // Filters get the frame the way it is shown.
+        texture->setOrientation(orientation, horizontalMirror, verticalMirror);
         node->markDirty(QSGNode::DirtyGeometry);
         m_geometryChanged = false;
+
+        reconfigure = m_queryProbeId && updatePreferredSize(rect, orientation);
     }
 
     locker.unlock();
 
-    texture->setBuffer(m_currentBuffer);
+    if (reconfigure) {
+        // Upstream queries the caps again and may pick the preferred size.
+        gst_pad_push_event(m_sinkPad, gst_event_new_reconfigure());
+    }
+
+    // Once released early the texture keeps what it has.
+    if (m_currentBuffer) {
+        texture->setBuffer(m_currentBuffer, m_currentSequence);
+    }
+
+    if (freeze && (m_currentBuffer || m_currentReleased)) {
+        // The texture holds on to the buffer until it has made its copy. Once it has let go of
+        // the pool's textures they are imported again with the next frame.
+        texture->freeze(m_displaySize);
+        m_poolReleased.storeRelease(1);
+        destroyReleaseFence();
+        if (m_currentBuffer) {
+            gst_buffer_unref(m_currentBuffer);
+            m_currentBuffer = nullptr;
+        }
+        m_currentReleased = true;
+    }
 
     if (bufferToRelease) {
         gst_buffer_unref(bufferToRelease);
@@ -763,9 +1797,51 @@ QAbstractVideoSurface *NemoVideoTextureBackend::videoSurface() const
     return nullptr;
 }
 
+// A filter can ask for smaller or cropped frames with the frameSize and frameCrop properties,
+// the crop being normalized to the video frame, and for luma or planar YUV frames with the
+// framePixelFormat property, a QVideoFrame::PixelFormat or one of "Y8", "NV12" and "YUV420P".
+// It can run only every frameInterval frames, or at most maximumFrameRate times a second.
+static void readFrameProperties(FilterInfo *info)
+{
+    info->frameInterval = qMax(1, info->filter->property("frameInterval").toInt());
+    info->maximumFrameRate = qMax<qreal>(0, info->filter->property("maximumFrameRate").toReal());
+
+    const QVariant format = info->filter->property("framePixelFormat");
+    const QByteArray formatName = format.toByteArray();
+    if (formatName == "Y8") {
+        info->framePixelFormat = QVideoFrame::Format_Y8;
+    } else if (formatName == "NV12") {
+        info->framePixelFormat = QVideoFrame::Format_NV12;
+    } else if (formatName == "YUV420P") {
+        info->framePixelFormat = QVideoFrame::Format_YUV420P;
+    } else {
+        switch (format.toInt()) {
+        case QVideoFrame::Format_Y8:
+        case QVideoFrame::Format_NV12:
+        case QVideoFrame::Format_YUV420P:
+            info->framePixelFormat = QVideoFrame::PixelFormat(format.toInt());
+            break;
+        default:
+            info->framePixelFormat = QVideoFrame::Format_BGRA32;
+            break;
+        }
+    }
+
+    info->frameSize = info->filter->property("frameSize").toSize();
+
+    const QVariant crop = info->filter->property("frameCrop");
+    info->frameCrop = crop.isValid()
+            ? crop.toRectF().intersected(QRectF(0, 0, 1, 1))
+            : QRectF(0, 0, 1, 1);
+    if (info->frameCrop.isEmpty()) {
+        info->frameCrop = QRectF(0, 0, 1, 1);
+    }
+}
+
 void NemoVideoTextureBackend::appendFilter(QAbstractVideoFilter *filter)
 {
     m_filtersChanged = true;
+    filter->installEventFilter(this);
     for (auto it = m_filters.begin(); it != m_filters.end(); ++it) {
         FilterInfo &info = *it;
 
@@ -773,17 +1849,24 @@ void NemoVideoTextureBackend::appendFilter(QAbstractVideoFilter *filter)
             // Pointers make lousy unique ids as they can be recycled after an object is destroyed.
             // So is removed or moved we'll flag it and delay removing until it has been synced.
             info.create = info.destroy;
+            readFrameProperties(&info);
             std::rotate(it, it + 1, m_filters.end());
             return;
         }
     }
-    m_filters.append(FilterInfo(filter));
+    FilterInfo info(filter);
+    readFrameProperties(&info);
+    m_filters.append(info);
 }
 
 void NemoVideoTextureBackend::clearFilters()
 {
     m_filtersChanged = true;
     for (auto it = m_filters.begin(); it != m_filters.end();) {
+        // The filter may go on in another output, its events are no longer ours.
+        if (it->filter) {
+            it->filter->removeEventFilter(this);
+        }
         if (it->created) {
             it->destroy = true;
             ++it;
@@ -806,7 +1889,15 @@ QRectF NemoVideoTextureBackend::adjustedViewport() const
 
 bool NemoVideoTextureBackend::event(QEvent *event)
 {
-    if (event->type() == QEvent::Resize) {
+    if (event->type() == statisticsEventType()) {
+        q->setProperty("textureMemory", m_textureMemory.load());
+        q->setProperty("texturesRetained", m_texturesRetained.load());
+        q->setProperty("texturesTrimmed", m_texturesTrimmed.load());
+        if (m_firstSmoothFrameTime.load() >= 0) {
+            q->setProperty("firstSmoothFrameTime", m_firstSmoothFrameTime.load());
+        }
+        return true;
+    } else if (event->type() == QEvent::Resize) {
         QSize nativeSize = static_cast<QResizeEvent *>(event)->size();
         if (nativeSize.isValid()) {
             {
@@ -827,19 +1918,92 @@ bool NemoVideoTextureBackend::event(QEvent *event)
     }
 }
 
+bool NemoVideoTextureBackend::eventFilter(QObject *object, QEvent *event)
+{
+    if (object == m_window) {
+        if (event->type() == QEvent::Expose) {
+            updateSuspended();
+        }
+        return QObject::eventFilter(object, event);
+    } else if (object == q) {
+        if (event->type() == QEvent::DynamicPropertyChange
+                && static_cast<QDynamicPropertyChangeEvent *>(event)->propertyName() == "textureBudget") {
+            QMutexLocker locker(&m_mutex);
+            m_textureBudget = textureBudget(q->property("textureBudget"));
+            locker.unlock();
+            q->update();
+        }
+        return QObject::eventFilter(object, event);
+    }
+    if (event->type() == FilterStatisticsEvent::eventType()) {
+        const FilterStatisticsEvent * const statistics = static_cast<FilterStatisticsEvent *>(event);
+        object->setProperty("framesFiltered", statistics->framesFiltered);
+        object->setProperty("framesDropped", statistics->framesDropped);
+        object->setProperty("filterLatency", statistics->latency);
+        return true;
+    }
+    if (event->type() == QEvent::DynamicPropertyChange) {
+        const QByteArray name = static_cast<QDynamicPropertyChangeEvent *>(event)->propertyName();
+        if (name == "frameSize"
+                || name == "frameCrop"
+                || name == "framePixelFormat"
+                || name == "frameInterval"
+                || name == "maximumFrameRate") {
+            for (FilterInfo &info : m_filters) {
+                if (info.filter == object && !info.destroy) {
+                    readFrameProperties(&info);
+                    m_filtersChanged = true;
+                }
+            }
+            q->update();
+        }
+    }
+    return QObject::eventFilter(object, event);
+}
+
 void NemoVideoTextureBackend::show_frame(GstVideoSink *, GstBuffer *buffer, void *data)
 {
     NemoVideoTextureBackend *instance = static_cast<NemoVideoTextureBackend *>(data);
 
-    QMutexLocker locker(&instance->m_mutex);
+    // Nothing of a hidden item is drawn, the frame isn't imported or kept. Upstream may be told
+    // with QoS events, as if the renderer couldn't keep up.
+    static const bool suspendQos = qEnvironmentVariableIntValue("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_SUSPEND_QOS") != 0;
+    if (buffer && instance->m_suspended.loadAcquire()) {
+        if (suspendQos) {
+            instance->updateQos(
+                        buffer,
+                        GST_BUFFER_PTS_IS_VALID(buffer)
+                            ? gst_segment_to_running_time(&instance->m_segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buffer))
+                            : GST_CLOCK_TIME_NONE,
+                        true);
+        }
+        return;
+    }
 
-    GstBuffer * const bufferToRelease = instance->m_queuedBuffer;
-    instance->m_queuedBuffer = buffer ? gst_buffer_ref(buffer) : nullptr;
+    QueuedFrame frame;
+    frame.buffer = buffer;
+    if (buffer && GST_BUFFER_PTS_IS_VALID(buffer)) {
+        frame.runningTime = gst_segment_to_running_time(
+                    &instance->m_segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buffer));
+    }
+    if (buffer && instance->m_trace) {
+        frame.sequence = instance->m_trace->begin(GST_BUFFER_PTS(buffer));
+    }
 
-    locker.unlock();
+    if (buffer) {
+        instance->prewarm(buffer);
+    }
 
-    if (bufferToRelease) {
-        gst_buffer_unref(bufferToRelease);
+    // Never take m_mutex here, the streaming thread must not wait for the render thread.
+    const bool overwritten = instance->m_frameQueue
+            ? instance->m_frameQueue->push(frame)
+            : instance->m_mailbox.publish(frame);
+
+    if (buffer) {
+        instance->updateQos(buffer, frame.runningTime, overwritten);
+        if (instance->m_frameQueue) {
+            instance->updateQueueAhead();
+        }
     }
 
     instance->requestUpdate();
@@ -849,15 +2013,285 @@ void NemoVideoTextureBackend::buffers_invalidated(GstVideoSink *, void *data)
 {
     NemoVideoTextureBackend *instance = static_cast<NemoVideoTextureBackend *>(data);
 
+    instance->m_buffersInvalidated.storeRelease(true);
+    instance->m_poolInvalidated.storeRelease(true);
+
+    instance->requestUpdate();
+}
+
+
+// Tells upstream when frames are thrown away before the render thread ever picked them up,
+// or when they reach the screen more than a frame late, so decoders can skip work.
+void NemoVideoTextureBackend::updateQos(GstBuffer *buffer, GstClockTime runningTime, bool overwritten)
+{
+    if (overwritten) {
+        m_framesDropped.ref();
+    }
+
+    if (GST_BUFFER_DURATION_IS_VALID(buffer)) {
+        m_frameDuration = GST_BUFFER_DURATION(buffer);
+    } else if (GST_CLOCK_TIME_IS_VALID(runningTime)
+               && GST_CLOCK_TIME_IS_VALID(m_lastRunningTime)
+               && runningTime > m_lastRunningTime) {
+        m_frameDuration = runningTime - m_lastRunningTime;
+    }
+    m_lastRunningTime = runningTime;
+
+    const GstClockTime now = gst_util_get_timestamp();
+    if (!GST_CLOCK_TIME_IS_VALID(runningTime)) {
+        return;
+    } else if (!GST_CLOCK_TIME_IS_VALID(m_qosTime)) {
+        m_qosTime = now;
+        return;
+    } else if (now - m_qosTime < c_qosInterval) {
+        return;
+    }
+    m_qosTime = now;
+
+    const int consumed = m_framesConsumed.fetchAndStoreRelaxed(0);
+    const int dropped = m_framesDropped.fetchAndStoreRelaxed(0);
+    GstClockTimeDiff lateness = m_renderLateness.load();
+
+    if (consumed + dropped == 0) {
+        return;
+    }
+
+    // Less than a frame late is jitter of the render loop, not something to skip frames for.
+    if (!GST_CLOCK_TIME_IS_VALID(m_frameDuration) || lateness <= GstClockTimeDiff(m_frameDuration)) {
+        lateness = 0;
+    }
+
+    // The proportion of the rate frames arrive at to the rate they are rendered at.
+    const double proportion = consumed > 0
+            ? double(consumed + dropped) / consumed
+            : double(consumed + dropped);
+
+    // Dropped frames say the renderer is behind even if the frames it picks up are on time,
+    // express that as the share of a frame it misses so the decoder has a lateness to act on.
+    if (dropped > 0 && GST_CLOCK_TIME_IS_VALID(m_frameDuration)) {
+        lateness = qMax(lateness, GstClockTimeDiff(m_frameDuration * (proportion - 1.0)));
+    }
+
+    // Keep quiet while all is well, but report once when recovering so upstream stops skipping.
+    if (dropped == 0 && lateness <= 0 && m_qosProportion <= 1.0) {
+        return;
+    }
+    m_qosProportion = dropped > 0 || lateness > 0 ? proportion : 1.0;
+
+    qCDebug(Qos) << "consumed" << consumed << "dropped" << dropped
+                 << "proportion" << m_qosProportion << "lateness" << lateness;
+
+    gst_pad_push_event(m_sinkPad, gst_event_new_qos(
+                           dropped > 0 ? GST_QOS_TYPE_OVERFLOW : GST_QOS_TYPE_UNDERFLOW,
+                           m_qosProportion,
+                           qMax<GstClockTimeDiff>(lateness, 0),
+                           runningTime));
+}
+
+class NemoVideoTextureBackend::Importer : public QRunnable
+{
+public:
+    Importer(NemoVideoTextureBackend *backend, const QVector<GstMemory *> &memories)
+        : m_backend(backend)
+        , m_memories(memories)
     {
-        QMutexLocker locker(&instance->m_mutex);
+    }
 
-        instance->m_buffersInvalidated = true;
+    void run() override
+    {
+        m_backend->importMemories(m_memories);
     }
 
-    instance->requestUpdate();
+private:
+    NemoVideoTextureBackend * const m_backend;
+    const QVector<GstMemory *> m_memories;
+};
+
+// Creating the images of new buffers in the background leaves the render thread only the texture
+// bind when a buffer is first shown. The memories of a pool's buffers are learned as they pass, and
+// imported again after the render thread let go of their textures, without ever taking buffers
+// from the pool, which belongs to upstream.
+void NemoVideoTextureBackend::prewarm(GstBuffer *buffer)
+{
+    if (gst_buffer_n_memory(buffer) == 0) {
+        return;
+    }
+
+    if (m_poolInvalidated.fetchAndStoreAcquire(false)) {
+        forgetPool();
+    }
+    const bool released = m_poolReleased.fetchAndStoreAcquire(false);
+
+    static const bool noPrewarm = qEnvironmentVariableIntValue("QTMULTIMEDIA_VIDEO_TEXTURE_BACKEND_NO_PREWARM") != 0;
+    GstBufferPool * const pool = noPrewarm ? nullptr : buffer->pool;
+    if (pool != m_prewarmedPool) {
+        forgetPool();
+        if (pool) {
+            m_prewarmedPool = GST_BUFFER_POOL(gst_object_ref(GST_OBJECT(pool)));
+        }
+    }
+
+    QVector<GstMemory *> memories;
+    if (released) {
+        for (GstMemory *memory : m_poolMemories) {
+            memories.append(gst_memory_ref(memory));
+        }
+    }
+
+    GstMemory * const memory = gst_buffer_peek_memory(buffer, 0);
+    if (!m_poolMemories.contains(memory)) {
+        if (pool && m_poolMemories.count() < textureCacheCapacity()) {
+            m_poolMemories.append(gst_memory_ref(memory));
+        }
+        memories.prepend(gst_memory_ref(memory));
+    }
+
+    if (!memories.isEmpty()) {
+        m_importPool.start(new Importer(this, memories));
+    }
+}
+
+// Worker thread, takes the references to memories.
+void NemoVideoTextureBackend::importMemories(const QVector<GstMemory *> &memories)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<GstMemory *> imported;
+    for (GstMemory *memory : memories) {
+        if (importImage(memory, m_display)) {
+            imported.append(memory);
+        } else {
+            gst_memory_unref(memory);
+        }
+    }
+
+    if (!imported.isEmpty()) {
+        qCDebug(Timing) << "imported" << imported.count() << "images in" << timer.elapsed();
+
+        QMutexLocker locker(&m_prewarmMutex);
+        m_prewarmedMemories += imported;
+    }
+}
+
+// Streaming thread.
+void NemoVideoTextureBackend::forgetPool()
+{
+    for (GstMemory *memory : m_poolMemories) {
+        gst_memory_unref(memory);
+    }
+    m_poolMemories.clear();
+
+    if (m_prewarmedPool) {
+        gst_object_unref(GST_OBJECT(m_prewarmedPool));
+        m_prewarmedPool = nullptr;
+    }
 }
 
+// The sink syncs each frame to the clock before show-frame, so every frame would be due the moment
+// it arrives and the queue would never hold more than the mailbox. Offsetting the sink by all but
+// one of the queue's frames hands them over early enough to be picked by their running time.
+void NemoVideoTextureBackend::updateQueueAhead()
+{
+    if (!GST_CLOCK_TIME_IS_VALID(m_frameDuration)) {
+        return;
+    }
+
+    const GstClockTime ahead = (m_frameQueue->capacity() - 1) * m_frameDuration;
+    // Durations measured between frames jitter, don't touch the sink for that.
+    if (qAbs(GST_CLOCK_DIFF(m_queueAhead, ahead)) > GST_MSECOND) {
+        m_queueAhead = ahead;
+        g_object_set(G_OBJECT(m_sink), "ts-offset", -GstClockTimeDiff(ahead), NULL);
+    }
+}
+
+void NemoVideoTextureBackend::resetQos()
+{
+    m_framesConsumed.store(0);
+    m_framesDropped.store(0);
+    m_renderLateness.store(0);
+    m_qosTime = GST_CLOCK_TIME_NONE;
+    m_lastRunningTime = GST_CLOCK_TIME_NONE;
+    m_qosProportion = 1.0;
+}
+
+// The size of the video on screen in pixels, in the orientation of the stream, or an invalid
+// size if the whole source is needed. Only changes by more than a quarter count, so a resizing
+// item doesn't renegotiate on every frame. Called with the mutex locked.
+bool NemoVideoTextureBackend::updatePreferredSize(const QRectF &rect, int orientation)
+{
+    QSizeF displayed = rect.size() * (q->window() ? q->window()->devicePixelRatio() : 1.0);
+    if (orientation % 180 != 0) {
+        displayed.transpose();
+    }
+
+    QSize preferred;
+    if (m_sourceSize.isValid() && !displayed.isEmpty()) {
+        // Enough pixels to cover the displayed size, in the aspect ratio of the source.
+        const QSizeF scaled = QSizeF(m_sourceSize).scaled(displayed, Qt::KeepAspectRatioByExpanding);
+        if (scaled.width() < m_sourceSize.width() * 0.8) {
+            preferred = QSize(qCeil(scaled.width() / 2) * 2, qCeil(scaled.height() / 2) * 2);
+        }
+    }
+
+    if (preferred.isValid() == m_preferredSize.isValid()
+            && (!preferred.isValid()
+                || (preferred.width() > m_preferredSize.width() * 0.8
+                    && preferred.width() < m_preferredSize.width() * 1.25))) {
+        return false;
+    }
+
+    qCDebug(Timing) << "preferring frames of" << preferred << "for" << displayed << "on screen";
+    m_preferredSize = preferred;
+    return true;
+}
+
+// Puts caps restricted to the preferred size ahead of the caps the sink supports, so upstream
+// fixates to it if it can and falls back to any size if not.
+GstPadProbeReturn NemoVideoTextureBackend::queryProbe(GstPad *, GstPadProbeInfo *info, void *data)
+{
+    NemoVideoTextureBackend * const instance = static_cast<NemoVideoTextureBackend *>(data);
+    GstQuery * const query = gst_pad_probe_info_get_query(info);
+    if (!query
+            || GST_QUERY_TYPE(query) != GST_QUERY_CAPS
+            || !(GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_PULL)) {
+        return GST_PAD_PROBE_OK;
+    }
+
+    QSize preferredSize;
+    {
+        QMutexLocker locker(&instance->m_mutex);
+        preferredSize = instance->m_preferredSize;
+    }
+
+    GstCaps *caps = nullptr;
+    gst_query_parse_caps_result(query, &caps);
+    if (!preferredSize.isValid() || !caps || gst_caps_is_any(caps) || gst_caps_is_empty(caps)) {
+        return GST_PAD_PROBE_OK;
+    }
+
+    GstCaps * const preferredCaps = gst_caps_copy(caps);
+    for (guint i = 0; i < gst_caps_get_size(preferredCaps); ++i) {
+        gst_structure_set(
+                    gst_caps_get_structure(preferredCaps, i),
+                    "width", G_TYPE_INT, preferredSize.width(),
+                    "height", G_TYPE_INT, preferredSize.height(),
+                    NULL);
+    }
+
+    GstCaps * const result = gst_caps_intersect_full(preferredCaps, caps, GST_CAPS_INTERSECT_FIRST);
+    gst_caps_unref(preferredCaps);
+    if (gst_caps_is_empty(result)) {
+        gst_caps_unref(result);
+        return GST_PAD_PROBE_OK;
+    }
+
+    gst_caps_append(result, gst_caps_ref(caps));
+    gst_query_set_caps_result(query, result);
+    gst_caps_unref(result);
+
+    return GST_PAD_PROBE_OK;
+}
 
 GstPadProbeReturn NemoVideoTextureBackend::probe(GstPad *, GstPadProbeInfo *info, void *data)
 {
@@ -867,6 +2301,34 @@ GstPadProbeReturn NemoVideoTextureBackend::probe(GstPad *, GstPadProbeInfo *info
         return GST_PAD_PROBE_OK;
     }
 
+    if (GST_EVENT_TYPE(event) == GST_EVENT_SEGMENT) {
+        // Serialized with show_frame() on the streaming thread, no lock needed.
+        gst_event_copy_segment(event, &instance->m_segment);
+        return GST_PAD_PROBE_OK;
+    } else if (GST_EVENT_TYPE(event) == GST_EVENT_EOS) {
+        // No frame follows until the stream is restarted.
+        if (instance->m_freezeFrames) {
+            instance->m_freezeRequested.storeRelease(1);
+            instance->requestUpdate();
+        }
+        return GST_PAD_PROBE_OK;
+    } else if (GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_START) {
+        // New frames soon follow a seek, so a flush only arms the pause timer, which
+        // every update request restarts.
+        if (instance->m_freezeFrames) {
+            instance->requestUpdate();
+        }
+        return GST_PAD_PROBE_OK;
+    } else if (GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_STOP) {
+        // Queued frames belong to the old segment and would never become due.
+        if (instance->m_frameQueue) {
+            instance->m_frameQueue->flush();
+            instance->requestUpdate();
+        }
+        instance->resetQos();
+        return GST_PAD_PROBE_OK;
+    }
+
     QMutexLocker locker(&instance->m_mutex);
 
     QSize implicitSize = instance->m_implicitSize;
@@ -883,7 +2345,13 @@ GstPadProbeReturn NemoVideoTextureBackend::probe(GstPad *, GstPadProbeInfo *info
         gst_structure_get_int(structure, "width", &textureSize.rwidth());
         gst_structure_get_int(structure, "height", &textureSize.rheight());
 
-        implicitSize = textureSize;
+        // Frames of a preferred size are still shown at the size of the source. Caps of any other
+        // size are the source's own, which an adaptive stream may also lower mid stream.
+        if (!textureSize.isEmpty() && textureSize != instance->m_preferredSize) {
+            instance->m_sourceSize = textureSize;
+        }
+
+        implicitSize = instance->m_sourceSize.isValid() ? instance->m_sourceSize : textureSize;
         gint numerator = 0;
         gint denominator = 0;
         if (gst_structure_get_fraction(structure, "pixel-aspect-ratio", &numerator, &denominator)
@@ -913,6 +2381,9 @@ GstPadProbeReturn NemoVideoTextureBackend::probe(GstPad *, GstPadProbeInfo *info
         g_free(orientationTag);
     } else if (GST_EVENT_TYPE(event) == GST_EVENT_STREAM_START) {
         orientation = 0;
+        // A new stream has to be seen at its own size first.
+        instance->m_sourceSize = QSize();
+        instance->m_preferredSize = QSize();
     }
 
     if (instance->m_textureOrientation != orientation || instance->m_implicitSize != implicitSize) {
@@ -35,7 +35,9 @@
 #include <private/qdeclarativevideooutput_backend_p.h>
 #include <private/qdeclarativevideooutput_p.h>
 
+#include <QAtomicInteger>
 #include <QGuiApplication>
+#include <QMatrix4x4>
 #include <QMediaObject>
 #include <QMediaService>
 #include <QMutex>
@@ -48,6 +50,8 @@
 #include <QSGTexture>
 #include <QOpenGLContext>
 #include <QThread>
+#include <QThreadPool>
+#include <QTimer>
 #include <QRunnable>
 
 #include <qpa/qplatformnativeinterface.h>
@@ -59,6 +63,11 @@
 #include <EGL/eglext.h>
 #include <gst/video/gstvideometa.h>
 
+#include "asyncfilterchain.h"
+#include "framemailbox.h"
+#include "framequeue.h"
+#include "frametrace.h"
+#include "texturecache.h"
 #include "texturevideobuffer.h"
 
 namespace NemoVideoBackend {
@@ -71,6 +80,25 @@ struct FilterInfo {
     bool destroy = false;
     bool create = true;
     bool created = false;
+    void setFrameProperties(const FilterInfo &other)
+    {
+        frameSize = other.frameSize;
+        frameCrop = other.frameCrop;
+        framePixelFormat = other.framePixelFormat;
+        frameInterval = other.frameInterval;
+        maximumFrameRate = other.maximumFrameRate;
+    }
+
+    // the frameSize, frameCrop, framePixelFormat, frameInterval and maximumFrameRate
+    // dynamic properties of the filter
+    QSize frameSize;
+    QRectF frameCrop = QRectF(0, 0, 1, 1);
+    QVideoFrame::PixelFormat framePixelFormat = QVideoFrame::Format_BGRA32;
+    int frameInterval = 1;
+    qreal maximumFrameRate = 0;
+    // the filter runs on the frames where frame % interval == phase
+    int interval = 1;
+    int phase = 0;
 };
 
 
@@ -84,6 +112,7 @@ public:
     int textureId() const override;
     QSize textureSize() const override;
     void setTextureSize(const QSize &size);
+    void setOrientation(int orientation, bool horizontalMirror, bool verticalMirror);
     bool hasAlphaChannel() const override;
     bool hasMipmaps() const override;
 
@@ -95,35 +124,94 @@ public:
     void invalidateTexture();
     void invalidated();
 
-    void setBuffer(GstBuffer *buffer);
+    void setBuffer(GstBuffer *buffer, quint64 sequence = 0);
+    void releaseBuffer();
     void invalidateBuffers();
+    void setTrace(FrameTrace *trace);
+    // Takes the references to memories, textures for their imported images are created one a frame.
+    void prewarm(const QVector<GstMemory *> &memories);
+    // Milliseconds from the first frame to the last one which had to be imported, once
+    // playback has been smooth for a while, or -1.
+    qint64 firstSmoothFrameTime() const { return m_firstSmoothFrameTime; }
     void syncFilters(QVector<FilterInfo> &filters);
 
     void resetTextures();
 
+    // Keeps the textures of buffers other than the one shown within bytes, negative for no limit.
+    void setRetentionBudget(qint64 bytes);
+    // Drops all textures but the one shown, returns how many.
+    int trimTextures();
+    // Shows a copy of the current frame, no larger than displaySize, from the next update on
+    // and lets go of the buffer and all textures, until a new frame is set.
+    void freeze(const QSize &displaySize) { m_freezePending = true; m_freezeSize = displaySize; }
+    int texturesRetained() const { return m_textures.count(); }
+    qint64 textureMemory() const { return m_textures.bytes(); }
+    // Textures dropped to stay within the budget or by trimming.
+    quint64 texturesTrimmed() const { return m_texturesTrimmed; }
+
+    // The frame is shown from the external texture, not from a frame a filter returned.
+    bool isExternal() const { return m_filteredTextureId == 0; }
+    bool swapRedBlue() const { return m_filteredSwapRedBlue; }
+    // Maps the texture coordinates of the node to those of the filtered frame, which is
+    // already rotated and mirrored.
+    QMatrix4x4 filteredFrameMatrix() const;
+
 private:
     inline  void callVideoFilterRunnables();
-    inline void destroyCachedTextures();
-
-    struct CachedTexture
-    {
-        GstMemory *memory;
-        EGLImageKHR image;
-        GLuint textureId;
-    };
+    bool showFilteredFrame(QVideoFrame &frame);
+    void scheduleFilters();
+    int filterInterval(const FilterInfo &filter) const;
+    bool isDue(const FilterInfo &filter) const { return m_filterFrame % filter.interval == quint64(filter.phase); }
+    void queueVideoFilterRunnables();
+    void runVideoFilterRunnablesInParallel();
+    TextureVideoBuffer *videoBuffer(const FilterInfo &filter);
+    qint64 textureBytes() const;
+    void prewarmNext();
+    bool freezeFrame();
 
     GstBuffer *m_buffer;
+    FrameTrace *m_trace;
+    quint64 m_sequence;
     EGLDisplay m_display;
-    std::vector<CachedTexture> m_textures;
+    TextureCache m_textures;
+    qint64 m_retentionBudget;
+    quint64 m_texturesTrimmed;
+    GstMemory *m_currentMemory;     // of the texture shown, not referenced
+    QVector<GstMemory *> m_prewarmMemories;
+    GstClockTime m_firstFrameTime;
+    GstClockTime m_lastImportTime;
+    qint64 m_firstSmoothFrameTime;
     QRectF m_subRect;
     QSize m_textureSize;
+    int m_orientation;
+    bool m_horizontalMirror;
+    bool m_verticalMirror;
     GLuint m_textureId;
     bool m_bufferChanged;
     bool m_buffersInvalidated;
-
-    // to get pixels from each video frame
-    QScopedPointer<TextureVideoBuffer> m_videoBuffer;
+    bool m_freezePending;
+    QSize m_freezeSize;
+    // renders the frozen copy, its FBO is kept while the copy is shown
+    std::unique_ptr<TextureVideoBuffer> m_frozenFrame;
+    bool m_smoothReported;
+
+    // to get pixels from each video frame, one for each frame geometry filters ask for
+    std::vector<std::unique_ptr<TextureVideoBuffer>> m_videoBuffers;
     QVector<FilterInfo> m_filters;
+    quint64 m_filterFrame;
+    GstClockTime m_lastFrameTime;
+    qreal m_frameRate;
+    std::unique_ptr<AsyncFilterChain> m_asyncFilters;
+    std::unique_ptr<QThreadPool> m_filterPool;
+
+    // a frame returned by the filters, shown instead of the video frame
+    QVideoFrame m_filteredFrame;
+    GLuint m_filteredTextureId;
+    bool m_filteredSwapRedBlue;
+    // memory frames are uploaded to these in turn
+    GLuint m_uploadTextures[2];
+    int m_nextUpload;
+    QSize m_uploadSize;
 };
 
 class GStreamerVideoMaterial : public QObject, public QSGMaterial
@@ -188,6 +276,7 @@ public:
     QRectF adjustedViewport() const override;
 
     bool event(QEvent *event) override;
+    bool eventFilter(QObject *object, QEvent *event) override;
 
 signals:
     void requestUpdate();
@@ -200,9 +289,33 @@ private slots:
     void orientationChanged();
     void sourceChanged();
     void cameraStateChanged(QCamera::State newState);
+    void frameSwapped();
+    void afterRendering();
+    void sceneGraphAboutToStop();
+    void updateSuspended();
+    void lowMemory();
+    void freezeFrame();
+    void writeTrace();
 
 private:
+    GstClockTime nextPresentationTime() const;
+    void updateQos(GstBuffer *buffer, GstClockTime runningTime, bool overwritten);
+    void resetQos();
+    void updateQueueAhead();
+    void destroyReleaseFence();
+    void prewarm(GstBuffer *buffer);
+    void importMemories(const QVector<GstMemory *> &memories);
+    void forgetPool();
+
+    bool updatePreferredSize(const QRectF &rect, int orientation);
+    void setWindow(QQuickWindow *window);
+    void reportRetention(const char *reason);
+    static qint64 textureBudget(const QVariant &kilobytes);
+
+    class Importer;
+
     static GstPadProbeReturn probe(GstPad *pad, GstPadProbeInfo *info, void *data);
+    static GstPadProbeReturn queryProbe(GstPad *pad, GstPadProbeInfo *info, void *data);
 
     inline static void show_frame(GstVideoSink *, GstBuffer *buffer, void *data);
     inline static void buffers_invalidated(GstVideoSink *sink, void *data);
@@ -210,22 +323,83 @@ private:
     QMutex m_mutex;
     QPointer<QGStreamerElementControl> m_control;
     GstElement* m_sink;
-    GstBuffer *m_queuedBuffer;
+    GstPad *m_sinkPad;
+    // written by the streaming thread and read by the render thread without locking
+    FrameMailbox m_mailbox;
+    // replaces the mailbox if frames are scheduled by their time stamps
+    QScopedPointer<FrameQueue> m_frameQueue;
+    GstClockTime m_queueAhead;      // streaming thread only
+    QAtomicInt m_buffersInvalidated;
+    // set while the item can't be seen, frames are dropped by the sink
+    QAtomicInt m_suspended;
+    // set to have the render thread drop the textures of buffers not shown
+    QAtomicInt m_trimTextures;
+    // set to have the render thread show a copy of the current frame and release its buffer
+    QAtomicInt m_freezeRequested;
+    QTimer m_freezeTimer;
+    bool m_freezeFrames;
+    // memories of a pool's buffers imported in the background, handed to the render thread
+    QMutex m_prewarmMutex;
+    QVector<GstMemory *> m_prewarmedMemories;
+    QThreadPool m_importPool;
+    // set to forget the pool, or to import the memories learned for it again
+    QAtomicInt m_poolInvalidated;
+    QAtomicInt m_poolReleased;
+    // the memories of the pool's buffers seen so far
+    GstBufferPool *m_prewarmedPool; // streaming thread only
+    QVector<GstMemory *> m_poolMemories;    // streaming thread only
     GstBuffer *m_currentBuffer;
+    EGLSyncKHR m_releaseFence;      // render thread only
+    QPointer<GStreamerVideoTexture> m_texture;  // render thread only
+    GstSegment m_segment;           // streaming thread only
+    GstClockTime m_lastSwapTime;    // render thread only
+    GstClockTime m_swapInterval;    // render thread only
+
+    // per frame time stamps, if enabled
+    QScopedPointer<FrameTrace> m_trace;
+    QString m_traceFile;
+    QTimer m_traceTimer;
+    quint64 m_currentSequence;      // render thread only
+    quint64 m_swapSequence;         // render thread only
+
+    // render statistics reported upstream as QoS events
+    QAtomicInt m_framesConsumed;
+    QAtomicInt m_framesDropped;
+    QAtomicInteger<qint64> m_renderLateness;
+    GstClockTime m_qosTime;             // streaming thread only
+    GstClockTime m_lastRunningTime;     // streaming thread only
+    GstClockTime m_frameDuration;       // streaming thread only
+    double m_qosProportion;             // streaming thread only
+
+    // texture retention, reported as properties of the output
+    qint64 m_textureBudget;
+    QAtomicInteger<qint64> m_textureMemory;
+    QAtomicInt m_texturesRetained;
+    QAtomicInteger<quint64> m_texturesTrimmed;
+    QAtomicInteger<qint64> m_firstSmoothFrameTime;
+    GstClockTime m_retentionReportTime; // render thread only
     EGLDisplay m_display;
     QCamera *m_camera;
+    QPointer<QQuickWindow> m_window;
     QSize m_nativeSize;
     QSize m_textureSize;
     QSize m_implicitSize;
+    // the frame size of the source's own caps, and the smaller size asked of upstream for the
+    // size the video is shown at, caps of which don't change the source size
+    QSize m_sourceSize;
+    QSize m_preferredSize;
+    QSize m_displaySize;    // render thread only
     gulong m_probeId;
+    gulong m_queryProbeId;
     gulong m_showFrameId;
     gulong m_buffersInvalidatedId;
     int m_orientation;
     int m_textureOrientation;
     bool m_mirror;
+    bool m_earlyRelease;
+    bool m_currentReleased;         // render thread only
     bool m_geometryChanged;
     bool m_filtersChanged;
-    bool m_buffersInvalidated;
 
     // to keep track of added video filters locally, to avoid doing
     //   q->filters() and dealing with QQmlListProperty
@@ -0,0 +1,46 @@
+# The backend sources, shared by the plugin and the benchmarks linking it statically.
+
+QT += \
+        gui \
+        gui-private \
+        quick \
+        multimedia \
+        multimedia-private \
+        qtmultimediaquicktools-private
+
+CONFIG += link_pkgconfig
+
+PKGCONFIG +=\
+        egl \
+        gstreamer-1.0 \
+        nemo-gstreamer-interfaces-1.0
+
+LIBS += -lqgsttools_p
+
+# It won't compile without this,
+# the issue is Xlib.h defines Bool as int but  QJsonValue.h has an enum with Bool = 0x1 --> int = 0x1 -> BOOM!
+DEFINES += MESA_EGL_NO_X11_HEADERS
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+        $$PWD/asyncfilterchain.cpp \
+        $$PWD/framemailbox.cpp \
+        $$PWD/framequeue.cpp \
+        $$PWD/frametrace.cpp \
+        $$PWD/memorypressure.cpp \
+        $$PWD/readbackpool.cpp \
+        $$PWD/texturecache.cpp \
+        $$PWD/texturevideobuffer.cpp \
+        $$PWD/videotexturebackend.cpp
+
+HEADERS += \
+        $$PWD/asyncfilterchain.h \
+        $$PWD/framemailbox.h \
+        $$PWD/framequeue.h \
+        $$PWD/frametrace.h \
+        $$PWD/memorypressure.h \
+        $$PWD/readbackpool.h \
+        $$PWD/texturecache.h \
+        $$PWD/texturevideobuffer.h \
+        $$PWD/videotexturebackend.h